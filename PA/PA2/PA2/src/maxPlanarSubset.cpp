@@ -1,21 +1,61 @@
+#include "mps.h"
+#include "perfScope.h"
 #include <iostream>
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <climits>
+#include <unordered_map>
 using namespace std;
 
-int vst_count = 0;
-pair<int,int> last_pair;
+bool trace = true;
+thread_local int vst_count = 0;
+thread_local pair<int,int> last_pair;
 inline unsigned long long index(int i, int j) {
     return ((unsigned long long)j * (j + 1) >> 1) + i;
 }
-inline int dp_get(const vector<int>& dp, int i, int j) {
+inline unsigned long long triangular(int n) {
+    return ((unsigned long long)n * (n + 1)) >> 1;
+}
+
+// Triangular dp table.  Cell is uint16_t when every answer fits below the
+// UNSET sentinel (n/2 < 65535), which halves the table; int32 otherwise.
+template <typename Cell>
+class DenseTable {
+public:
+    static constexpr Cell UNSET = static_cast<Cell>(-1);
+    DenseTable(vector<Cell>& cells, int n) : cells_(cells) { cells_.assign(triangular(n), UNSET); }
+    bool known(int i, int j) const { return cells_[index(i, j)] != UNSET; }
+    int get(int i, int j) const { return cells_[index(i, j)]; }
+    void set(int i, int j, int v) { cells_[index(i, j)] = static_cast<Cell>(v); }
+private:
+    vector<Cell>& cells_;
+};
+
+// Memo that only stores the states top-down actually reaches.
+class SparseTable {
+public:
+    explicit SparseTable(unsigned long long expected) { cells_.reserve(expected); }
+    bool known(int i, int j) const { return cells_.count(index(i, j)) != 0; }
+    int get(int i, int j) const { return cells_.at(index(i, j)); }
+    void set(int i, int j, int v) { cells_[index(i, j)] = v; }
+private:
+    unordered_map<unsigned long long, int> cells_;
+};
+
+template <typename Table>
+inline int dp_get(const Table& dp, int i, int j) {
     if (i >= j) return 0;
-    return dp[index(i, j)];
+    return dp.get(i, j);
+}
+template <typename Table>
+inline bool dp_known(const Table& dp, int i, int j) {
+    return i >= j || dp.known(i, j);
 }
 
+template <typename Table>
 static void reconstruct(const vector<int>& chords,
-                        const vector<int>& dp,
+                        const Table& dp,
                         int i, int j,
                         vector<pair<int,int>>& ans) {
     if (i >= j) return;
@@ -27,6 +67,13 @@ static void reconstruct(const vector<int>& chords,
         return;
     }
 
+    // td_compute never visits (i, j-1) when (i, j) is itself a chord
+    if (k == i && !dp_known(dp, i, j - 1)) {
+        reconstruct(chords, dp, i + 1, j - 1, ans);
+        ans.emplace_back(i, j);
+        return;
+    }
+
     int skip = dp_get(dp, i, j - 1);
     int left  = dp_get(dp, i, k - 1);
     int right = dp_get(dp, k + 1, j - 1);
@@ -41,112 +88,293 @@ static void reconstruct(const vector<int>& chords,
     }
 }
 
-int td_compute(const vector<int>& chords, int i, int j, vector<int>& dp)
+template <typename Table>
+int td_compute(const vector<int>& chords, int i, int j, Table& dp)
 {
-    if(vst_count < 3){
+    if(trace && vst_count < 3){
         printf("(%d,%d), ", i, j);
         vst_count++;
     }
     if (i >= j) return 0;
-    unsigned long long pos = index(i, j);
-    if (dp[pos] != -1) return dp[pos];
+    if (dp.known(i, j)) return dp.get(i, j);
     last_pair = make_pair(i, j);
     int k = chords[j];
+    int v;
     if (k == i) {
-        dp[pos] = td_compute(chords, i + 1, j - 1, dp) + 1;
+        v = td_compute(chords, i + 1, j - 1, dp) + 1;
     } else if (k < i || k > j) {
-        dp[pos] = td_compute(chords, i, j - 1, dp);
+        v = td_compute(chords, i, j - 1, dp);
     } else {
         int b = td_compute(chords, i, k - 1, dp) + td_compute(chords, k + 1, j - 1, dp) + 1;
         int a = td_compute(chords, i, j - 1, dp);
-        dp[pos] = max(a, b);
+        v = max(a, b);
     }
-    return dp[pos];
+    dp.set(i, j, v);
+    return v;
 }
 
-vector<pair<int,int>> tdMPS(const vector<int>& chords){
+template <typename Table>
+vector<pair<int,int>> tdMPS(const vector<int>& chords, Table& dp){
     int n = chords.size();
     vector<pair<int,int>> result;
-    unsigned long long sz = ((unsigned long long)n * (n + 1)) >> 1; // triangular size
-    vector<int> dp(sz, -1);
-    td_compute(chords, 0, n - 1, dp);
+    {
+        perf::Scope scope("td-fill");
+        td_compute(chords, 0, n - 1, dp);
+    }
+    perf::Scope scope("reconstruct");
     reconstruct(chords, dp, 0, n - 1, result);
     sort(result.begin(), result.end());
     return result;
 }
 
-vector<pair<int,int>> buMPS(const vector<int>& chords){
+template <typename Cell>
+vector<pair<int,int>> buMPS(const vector<int>& chords, vector<Cell>& cells){
     int n = chords.size();
-    unsigned long long sz = ((unsigned long long)n * (n + 1)) >> 1; // triangular size
-    vector<int> dp(sz, 0);
+    DenseTable<Cell> dp(cells, n);
     // compute dp table for lengths l = 1..n-1 (only i<j)
     // j 從 1..n-1（因為區間長度至少為 1），對每個 j，i 走 0..j-1
+    {
+    perf::Scope fill("bu-fill");
 for (int j = 1; j < n; ++j) {
     for (int i = 0; i < j; ++i) {
-        if (vst_count < 3) {
+        if (trace && vst_count < 3) {
             printf("(%d,%d), ", i, j);
             ++vst_count;
         }
 
         int k = chords[j];
-        unsigned long long pos = index(i, j);
         if (k < i || k >= j) {
-            dp[pos] = dp_get(dp, i, j - 1);
+            dp.set(i, j, dp_get(dp, i, j - 1));
         }
         else if (k == i) {
-            dp[pos] = dp_get(dp, i + 1, j - 1) + 1;
+            dp.set(i, j, dp_get(dp, i + 1, j - 1) + 1);
         }
         
         else {
             int left  = dp_get(dp, i,     k - 1);
             int right = dp_get(dp, k + 1, j - 1);
-            dp[pos] = max(dp_get(dp, i, j - 1), left + right + 1);
+            dp.set(i, j, max(dp_get(dp, i, j - 1), left + right + 1));
         }
     }
 }
 
+    }
+
     // reconstruct solution
     vector<pair<int,int>> result;
+    perf::Scope scope("reconstruct");
     reconstruct(chords, dp, 0, n - 1, result);
     sort(result.begin(), result.end());
     return result;
 }
+
+// ---- --method=auto ---------------------------------------------------------
+
+const unsigned long long SPARSE_STATE_BYTES = 48;  // hash node + bucket share
+const unsigned long long FRAME_BYTES = 128;         // td_compute / reconstruct frame
+
+bool narrow_cells(int n) { return n / 2 < 65535; }
+
+unsigned long long available_memory() {
+    ifstream meminfo("/proc/meminfo");
+    string key, rest;
+    unsigned long long kb;
+    while (meminfo >> key >> kb) {
+        getline(meminfo, rest);
+        if (key == "MemAvailable:") return kb << 10;
+    }
+    return 0;
+}
+
+// "1048576", "512M", "4G" (binary units); no sign, and no value that
+// overflows 64 bits once scaled
+bool parse_size(const string& s, unsigned long long& bytes) {
+    // stoull would take " -1" and wrap it to 2^64 - 1
+    if (s.empty() || s[0] < '0' || s[0] > '9') return false;
+    size_t used = 0;
+    unsigned long long v;
+    try { v = stoull(s, &used); } catch (...) { return false; }
+    string unit = s.substr(used);
+    int shift = 0;
+    if (unit == "K" || unit == "k") shift = 10;
+    else if (unit == "M" || unit == "m") shift = 20;
+    else if (unit == "G" || unit == "g") shift = 30;
+    else if (!unit.empty()) return false;
+    if (v > (ULLONG_MAX >> shift)) return false;
+    bytes = v << shift;
+    return true;
+}
+
+// Upper bound on the states td_compute can reach.  Apart from i = 0, an
+// interval only starts at a + 1 for the left end a of some chord (a, b), and
+// that family never goes above j = b - 1, so it holds at most b - a - 1 states.
+// The bound is n plus the sum of b - a - 1 over the chords: O(n) only when the
+// chords are short, O(n^2) in the worst case (nested chords (k, n - 1 - k)
+// give about n^2 / 4), so size memory from the sum, never from n.
+unsigned long long estimate_td_states(const vector<int>& chords) {
+    int n = chords.size();
+    unsigned long long states = n;
+    for (int a = 0; a < n; ++a)
+        if (chords[a] > a) states += chords[a] - a - 1;
+    return states;
+}
+
+inline unsigned long long mib(unsigned long long bytes) { return bytes >> 20; }
+
+bool choose_plan(const vector<int>& chords, unsigned long long budget, Plan& plan,
+                 bool verbose) {
+    int n = chords.size();
+    bool narrow = narrow_cells(n);
+    unsigned long long cells = triangular(n);
+    unsigned long long denseBytes = cells * (narrow ? 2 : 4);
+    unsigned long long states = estimate_td_states(chords);
+    unsigned long long sparseBytes = states * SPARSE_STATE_BYTES;
+    // both engines recurse once per interval shrink, so depth is bounded by n
+    unsigned long long stackBytes = (unsigned long long)n * FRAME_BYTES;
+
+    if (verbose)
+        cerr << "[auto] n=" << n << " budget=" << mib(budget) << "MiB"
+             << " dense=" << mib(denseBytes) << "MiB (" << cells << " cells)"
+             << " td-states<=" << states << " sparse=" << mib(sparseBytes) << "MiB"
+             << " depth<=" << n << " stack=" << mib(stackBytes) << "MiB\n";
+
+    bool denseFits = denseBytes + stackBytes <= budget;
+    bool sparseFits = sparseBytes + stackBytes <= budget;
+    // a hash probe costs ~30 sequential cell updates, so top-down only pays off
+    // when it skips almost all of the table
+    if (denseFits && !(sparseFits && states * 32 < cells)) {
+        plan = {"bu", narrow ? "dense16" : "dense32"};
+        if (verbose)
+            cerr << "[auto] bu/" << plan.table << ": whole table fits, sweep it bottom-up\n";
+        return true;
+    }
+    if (sparseFits) {
+        plan = {"td", "sparse"};
+        if (verbose)
+            cerr << "[auto] td/sparse: " << (denseFits ? "top-down reaches under 1/32 of the table"
+                                                       : "dense table exceeds budget")
+                 << ", memoize reachable states only\n";
+        return true;
+    }
+    if (verbose)
+        cerr << "mps: nothing fits in " << mib(budget) << "MiB: bu/dense needs "
+             << mib(denseBytes + stackBytes) << "MiB, td/sparse needs up to "
+             << mib(sparseBytes + stackBytes) << "MiB; raise --mem-limit or free memory\n";
+    return false;
+}
+
+vector<pair<int,int>> solve(const vector<int>& chords, const Plan& plan, DpBuffers& buffers) {
+    int n = chords.size();
+    if (plan.engine == "bu")
+        return plan.table == "dense16" ? buMPS(chords, buffers.narrow) : buMPS(chords, buffers.wide);
+    if (plan.table == "sparse") {
+        SparseTable dp(estimate_td_states(chords));
+        return tdMPS(chords, dp);
+    }
+    if (plan.table == "dense16") {
+        DenseTable<uint16_t> dp(buffers.narrow, n);
+        return tdMPS(chords, dp);
+    }
+    DenseTable<int> dp(buffers.wide, n);
+    return tdMPS(chords, dp);
+}
+
+bool start_thread(pthread_t& tid, size_t stackBytes, void* (*fn)(void*), void* arg) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackBytes);
+    int rc = pthread_create(&tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return rc == 0;
+}
+
+struct SolveJob {
+    const vector<int>* chords;
+    const Plan* plan;
+    vector<pair<int,int>> result;
+    pair<int,int> lastPair;
+};
+
+static void* solve_thread(void* arg) {
+    SolveJob* job = static_cast<SolveJob*>(arg);
+    DpBuffers buffers;
+    job->result = solve(*job->chords, *job->plan, buffers);
+    job->lastPair = last_pair;
+    return nullptr;
+}
+
+// td_compute and reconstruct recurse up to n deep, more than the default
+// 8 MiB stack holds on the big inputs, so solve on a thread sized for it.
+bool solve_on_big_stack(const vector<int>& chords, const Plan& plan,
+                        vector<pair<int,int>>& result) {
+    SolveJob job{&chords, &plan, {}, {}};
+    pthread_t tid;
+    size_t stackBytes = max<size_t>(8u << 20, (size_t)chords.size() * FRAME_BYTES * 2);
+    if (!start_thread(tid, stackBytes, solve_thread, &job)) return false;
+    pthread_join(tid, nullptr);
+    result = move(job.result);
+    last_pair = job.lastPair;
+    return true;
+}
+
 int main(int argc, char* argv[]) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
 
-    if (argc < 3) {
-        cerr << "Usage: ./mps <input> <output> [--method=td|bu]\n";
-        return 1;
-    }
+    const char* usage = "Usage: ./mps [--method=td|bu|auto] [--mem-limit=SIZE] [--profile] <input> <output>\n"
+                        "       ./mps --serve SOCKET [--workers=N] [--mem-limit=SIZE]\n";
     string method = "bu";
-    string inputFile, outputFile;
-
-    if (argc == 4) {
-        // 旗標放在最前面
-        string arg = argv[1];
-        if (arg.rfind("--method=", 0) != 0) { return 1; }
-        string m = arg.substr(9);
-        if (m == "td" || m == "bu") method = m;
-        else { cerr << "Unknown method: " << m << "\n"; return 1; }
-        inputFile = argv[2];
-        outputFile = argv[3];
-    } else if (argc == 3) {
-        // 沒帶 method，預設 bu
-        inputFile = argv[1];
-        outputFile = argv[2];
-    } else {
-        cerr << "Usage: ./mps <input> <output> [--method=td|bu]\n";
+    unsigned long long memLimit = 0;
+    string socketPath;
+    int workers = 0;
+    vector<string> files;
+
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--serve" && a + 1 < argc) {
+            socketPath = argv[++a];
+        } else if (arg.rfind("--workers=", 0) == 0) {
+            workers = atoi(arg.c_str() + 10);
+            if (workers <= 0) { cerr << "Bad --workers: " << arg.substr(10) << "\n"; return 1; }
+        } else if (arg.rfind("--method=", 0) == 0) {
+            string m = arg.substr(9);
+            if (m == "td" || m == "bu" || m == "auto") method = m;
+            else { cerr << "Unknown method: " << m << "\n"; return 1; }
+        } else if (arg.rfind("--mem-limit=", 0) == 0) {
+            if (!parse_size(arg.substr(12), memLimit) || memLimit == 0) {
+                cerr << "Bad --mem-limit: " << arg.substr(12) << "\n";
+                return 1;
+            }
+        } else if (arg == "--profile") {
+            perf::Profiler::instance().enable();
+        } else if (arg.rfind("--", 0) == 0) {
+            cerr << usage;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (!socketPath.empty()) {
+        if (!files.empty()) { cerr << usage; return 1; }
+        trace = false;
+        return serve(socketPath, workers, memLimit);
+    }
+    if (files.size() != 2) {
+        cerr << usage;
         return 1;
     }
+    string inputFile = files[0], outputFile = files[1];
 
     ifstream fin(inputFile);
     ofstream fout(outputFile);
     if (!fin || !fout) { cerr << "Error opening file.\n"; return 1; }
 
     int n;
+    vector<int> chords;
+    {
+    perf::Scope scope("parse");
     fin >> n;
-    vector<int> chords(n);
+    chords.resize(n);
     for (int i = 0; i < n; ++i) {
         int pre = 0;
         int back = 0;
@@ -157,16 +385,31 @@ int main(int argc, char* argv[]) {
     }
     // int zero;
     // fin >> zero;
+    }
+
+    Plan plan{method, narrow_cells(n) ? "dense16" : "dense32"};
+    if (method == "auto") {
+        unsigned long long budget = memLimit ? memLimit : available_memory();
+        if (budget == 0) {
+            cerr << "mps: cannot read MemAvailable from /proc/meminfo, pass --mem-limit\n";
+            return 1;
+        }
+        if (!choose_plan(chords, budget, plan, true)) return 1;
+    }
 
     vector<pair<int, int>> result;
-    if (method == "td") {
-        result = tdMPS(chords);
-    } else {
-        result = buMPS(chords);
+    if (!solve_on_big_stack(chords, plan, result)) {
+        cerr << "mps: cannot start solver thread\n";
+        return 1;
     }
     printf("..., (%d,%d)\n", last_pair.first, last_pair.second);
+    {
+    perf::Scope scope("write");
     fout << result.size() << "\n";
     for (const auto& chord : result) {
         fout << chord.first << " " << chord.second << "\n";
     }
+    fout.flush();
+    }
+    perf::Profiler::instance().report(cerr);
 }
\ No newline at end of file
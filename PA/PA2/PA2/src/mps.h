@@ -0,0 +1,38 @@
+// mps.h
+#ifndef MPS_H
+#define MPS_H
+
+#include <cstdint>
+#include <pthread.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct Plan {
+    std::string engine;  // "td" or "bu"
+    std::string table;   // "dense16", "dense32" or "sparse"
+};
+
+// Backing store for the dense dp tables.  A long-lived caller (the --serve
+// workers) keeps one per thread so the allocation survives between solves.
+struct DpBuffers {
+    std::vector<uint16_t> narrow;
+    std::vector<int> wide;
+};
+
+extern bool trace;  // print the visited-pair trace on stdout (CLI only)
+
+bool narrow_cells(int n);
+unsigned long long available_memory();
+bool parse_size(const std::string& s, unsigned long long& bytes);
+bool choose_plan(const std::vector<int>& chords, unsigned long long budget,
+                 Plan& plan, bool verbose);
+std::vector<std::pair<int,int>> solve(const std::vector<int>& chords,
+                                      const Plan& plan, DpBuffers& buffers);
+
+// pthread with an explicit stack size; both engines recurse up to n deep.
+bool start_thread(pthread_t& tid, size_t stackBytes, void* (*fn)(void*), void* arg);
+
+int serve(const std::string& socketPath, int workers, unsigned long long memLimit);
+
+#endif // MPS_H
@@ -0,0 +1,458 @@
+// mpsServer.cpp -- `mps --serve SOCKET`
+//
+// Protocol, per connection (requests may be pipelined, responses come back in
+// request order):
+//   text:   "<n>\n" followed by n/2 "<a> <b>" lines, i.e. an input file; the
+//           files' closing "0" line is accepted and skipped.  Answered with
+//           the output file format, or "ERR <reason>\n".
+//   binary: "MPSB", uint32 n, then n/2 pairs of uint32 (host byte order).
+//           Answered with "MPSR", uint32 count, count pairs of uint32, or
+//           "MPSE", uint32 length, reason.
+//   "STATS\n" returns one line of request and latency counters.
+#include "mps.h"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+const size_t WORKER_STACK = 64u << 20;
+const int MAX_POINTS = WORKER_STACK / 256;  // keeps the n-deep recursion on the stack
+
+volatile sig_atomic_t stopping = 0;
+void on_signal(int) { stopping = 1; }
+
+unsigned long long micros(Clock::duration d) {
+    return chrono::duration_cast<chrono::microseconds>(d).count();
+}
+
+class Stats {
+public:
+    void record(unsigned long long queueUs, unsigned long long solveUs,
+                unsigned long long totalUs, bool ok) {
+        lock_guard<mutex> lk(mu_);
+        ++requests_;
+        if (!ok) ++errors_;
+        queueUs_ += queueUs;
+        solveUs_ += solveUs;
+        totalUs_ += totalUs;
+        maxUs_ = max(maxUs_, totalUs);
+        int b = 0;
+        while (b < 39 && (2ull << b) <= totalUs) ++b;
+        ++buckets_[b];
+    }
+
+    string report() {
+        lock_guard<mutex> lk(mu_);
+        unsigned long long n = max(requests_, 1ull);
+        ostringstream os;
+        os << "STATS requests=" << requests_ << " errors=" << errors_
+           << " mean_us=" << totalUs_ / n << " p50_us=" << percentile(0.50)
+           << " p99_us=" << percentile(0.99) << " max_us=" << maxUs_
+           << " queue_mean_us=" << queueUs_ / n << " solve_mean_us=" << solveUs_ / n << "\n";
+        return os.str();
+    }
+
+private:
+    // upper edge of the log2 bucket holding the q-th request
+    unsigned long long percentile(double q) const {
+        unsigned long long want = (unsigned long long)(q * requests_ + 0.5), seen = 0;
+        for (int b = 0; b < 40; ++b) {
+            seen += buckets_[b];
+            if (seen >= want && seen > 0) return min(maxUs_, 2ull << b);
+        }
+        return maxUs_;
+    }
+
+    mutex mu_;
+    unsigned long long requests_ = 0, errors_ = 0;
+    unsigned long long queueUs_ = 0, solveUs_ = 0, totalUs_ = 0, maxUs_ = 0;
+    unsigned long long buckets_[40] = {};  // [2^b, 2^(b+1)) microseconds
+};
+
+bool write_all(int fd, const string& bytes) {
+    size_t off = 0;
+    while (off < bytes.size()) {
+        ssize_t w = ::write(fd, bytes.data() + off, bytes.size() - off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        off += w;
+    }
+    return true;
+}
+
+class Connection {
+public:
+    explicit Connection(int fd) : fd_(fd) {}
+    ~Connection() { ::close(fd_); }
+
+    int fd() const { return fd_; }
+    // wakes the handler's blocked read; queued responses still go out
+    void stop_reading() { ::shutdown(fd_, SHUT_RD); }
+
+    // Responses finish out of order on the pool; hold them until every
+    // earlier request on this connection has been written.
+    void deliver(unsigned long long seq, string bytes) {
+        lock_guard<mutex> lk(mu_);
+        ready_.emplace(seq, move(bytes));
+        while (!ready_.empty() && ready_.begin()->first == nextSeq_) {
+            if (!broken_) broken_ = !write_all(fd_, ready_.begin()->second);
+            ready_.erase(ready_.begin());
+            ++nextSeq_;
+        }
+    }
+
+private:
+    int fd_;
+    mutex mu_;
+    unsigned long long nextSeq_ = 0;
+    map<unsigned long long, string> ready_;
+    bool broken_ = false;
+};
+
+struct Job {
+    shared_ptr<Connection> conn;
+    unsigned long long seq;
+    bool binary;
+    vector<int> chords;
+    string error;  // rejected while parsing; answered without solving
+    Clock::time_point arrived;
+};
+
+class Reader {
+public:
+    explicit Reader(int fd) : fd_(fd) {}
+
+    int peek() {
+        if (pos_ == len_ && !fill()) return -1;
+        return (unsigned char)buf_[pos_];
+    }
+    bool skip_space() {
+        int c;
+        while ((c = peek()) != -1 && isspace(c)) ++pos_;
+        return c != -1;
+    }
+    bool token(string& out) {
+        out.clear();
+        if (!skip_space()) return false;
+        int c;
+        while ((c = peek()) != -1 && !isspace(c)) { out.push_back((char)c); ++pos_; }
+        return true;
+    }
+    bool exact(void* dst, size_t n) {
+        char* p = static_cast<char*>(dst);
+        while (n > 0) {
+            if (pos_ == len_ && !fill()) return false;
+            size_t take = min(n, len_ - pos_);
+            memcpy(p, buf_ + pos_, take);
+            pos_ += take;
+            p += take;
+            n -= take;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        ssize_t r;
+        do r = ::read(fd_, buf_, sizeof(buf_)); while (r < 0 && errno == EINTR);
+        if (r <= 0) return false;
+        pos_ = 0;
+        len_ = r;
+        return true;
+    }
+
+    int fd_;
+    char buf_[1 << 16];
+    size_t pos_ = 0, len_ = 0;
+};
+
+string text_response(const vector<pair<int,int>>& result) {
+    string out = to_string(result.size()) + "\n";
+    for (const auto& c : result) {
+        out += to_string(c.first);
+        out += ' ';
+        out += to_string(c.second);
+        out += '\n';
+    }
+    return out;
+}
+
+string binary_response(const vector<pair<int,int>>& result) {
+    string out("MPSR");
+    auto put = [&](uint32_t v) { out.append(reinterpret_cast<const char*>(&v), 4); };
+    put(result.size());
+    for (const auto& c : result) { put(c.first); put(c.second); }
+    return out;
+}
+
+string error_response(bool binary, const string& why) {
+    if (!binary) return "ERR " + why + "\n";
+    string out("MPSE");
+    uint32_t len = why.size();
+    out.append(reinterpret_cast<const char*>(&len), 4);
+    return out + why;
+}
+
+// Drops the dp buffer the plan will not reuse.  A worker then holds at most
+// one dense table, no larger than an earlier request's, which choose_plan
+// already kept within the worker's budget; without this a worker could sit
+// on a 16-bit and a 32-bit table, or on one next to a fresh sparse table.
+void release_unused(DpBuffers& buffers, const Plan& plan) {
+    if (plan.table != "dense16") vector<uint16_t>().swap(buffers.narrow);
+    if (plan.table != "dense32") vector<int>().swap(buffers.wide);
+}
+
+// Fills chords from (a, b) pairs; returns the reason on bad input.
+string place_chords(int n, const vector<uint32_t>& ends, vector<int>& chords) {
+    chords.assign(n, -1);
+    for (size_t p = 0; p + 1 < ends.size(); p += 2) {
+        uint32_t a = ends[p], b = ends[p + 1];
+        if (a >= (uint32_t)n || b >= (uint32_t)n || a == b)
+            return "endpoint out of range";
+        if (chords[a] != -1 || chords[b] != -1) return "endpoint used twice";
+        chords[a] = b;
+        chords[b] = a;
+    }
+    return "";
+}
+
+class Server {
+public:
+    Server(int workers, unsigned long long memLimit)
+        : workers_(workers), budget_(memLimit / workers) {}
+
+    bool start() {
+        for (int w = 0; w < workers_; ++w) {
+            pthread_t tid;
+            if (!start_thread(tid, WORKER_STACK, &Server::worker_main, this)) {
+                stop();
+                return false;
+            }
+            workerIds_.push_back(tid);
+        }
+        return true;
+    }
+
+    // One thread per connection; the ones that have finished are joined
+    // here, the rest in stop().
+    void accept_connection(int fd) {
+        for (auto it = handlers_.begin(); it != handlers_.end();) {
+            if (!*it->done) { ++it; continue; }
+            it->thread.join();
+            it = handlers_.erase(it);
+        }
+        auto conn = make_shared<Connection>(fd);
+        auto done = make_shared<atomic<bool>>(false);
+        handlers_.push_back({conn, thread([this, conn, done] { handle(conn); *done = true; }), done});
+    }
+
+    // Ends every connection's reads, answers what is already queued, then
+    // joins the handler and worker threads; nothing refers to the server
+    // after this returns.
+    void stop() {
+        for (Handler& h : handlers_)
+            if (shared_ptr<Connection> conn = h.conn.lock()) conn->stop_reading();
+        for (Handler& h : handlers_) h.thread.join();
+        handlers_.clear();
+        {
+            lock_guard<mutex> lk(mu_);
+            closing_ = true;
+        }
+        notEmpty_.notify_all();
+        for (pthread_t tid : workerIds_) pthread_join(tid, nullptr);
+        workerIds_.clear();
+    }
+
+    void handle(const shared_ptr<Connection>& conn) {
+        Reader in(conn->fd());
+        for (unsigned long long seq = 0;; ++seq) {
+            if (!in.skip_space()) return;
+            Job job{conn, seq, false, {}, "", Clock::now()};
+            if (in.peek() == 'M') {
+                char magic[4];
+                uint32_t n;
+                if (!in.exact(magic, 4) || memcmp(magic, "MPSB", 4) != 0 || !in.exact(&n, 4)) {
+                    conn->deliver(seq, error_response(true, "bad binary header"));
+                    return;
+                }
+                job.binary = true;
+                if (n % 2 != 0 || n > (uint32_t)MAX_POINTS) {
+                    conn->deliver(seq, error_response(true, "bad point count"));
+                    return;
+                }
+                vector<uint32_t> ends(n);
+                if (!in.exact(ends.data(), n * sizeof(uint32_t))) return;
+                job.error = place_chords(n, ends, job.chords);
+            } else {
+                string tok;
+                in.token(tok);
+                if (tok == "STATS") {
+                    conn->deliver(seq, stats_.report());
+                    continue;
+                }
+                if (tok == "0") {  // input file terminator, not a request
+                    --seq;
+                    continue;
+                }
+                char* end;
+                long n = strtol(tok.c_str(), &end, 10);
+                if (*end != '\0' || n < 0 || n % 2 != 0 || n > MAX_POINTS) {
+                    conn->deliver(seq, error_response(false, "bad point count"));
+                    return;
+                }
+                vector<uint32_t> ends(n);
+                for (long p = 0; p < n; ++p) {
+                    if (!in.token(tok)) return;
+                    long v = strtol(tok.c_str(), &end, 10);
+                    if (*end != '\0' || v < 0) {
+                        conn->deliver(seq, error_response(false, "bad endpoint"));
+                        return;
+                    }
+                    ends[p] = v;
+                }
+                job.error = place_chords(n, ends, job.chords);
+            }
+            push(move(job));
+        }
+    }
+
+    Stats& stats() { return stats_; }
+
+private:
+    void push(Job job) {
+        unique_lock<mutex> lk(mu_);
+        // bound the backlog so a fast pipelining client cannot queue unbounded work
+        notFull_.wait(lk, [&] { return queue_.size() < (size_t)workers_ * 4; });
+        queue_.push_back(move(job));
+        notEmpty_.notify_one();
+    }
+
+    static void* worker_main(void* self) {
+        static_cast<Server*>(self)->work();
+        return nullptr;
+    }
+
+    void work() {
+        DpBuffers buffers;  // reused across every request this worker solves
+        for (;;) {
+            Job job;
+            {
+                unique_lock<mutex> lk(mu_);
+                notEmpty_.wait(lk, [&] { return !queue_.empty() || closing_; });
+                if (queue_.empty()) return;
+                job = move(queue_.front());
+                queue_.pop_front();
+                notFull_.notify_one();
+            }
+            Clock::time_point begin = Clock::now();
+            string reply, why = job.error;
+            Plan plan;
+            if (why.empty() && !choose_plan(job.chords, budget_, plan, false))
+                why = "does not fit in the per-worker memory budget";
+            if (why.empty()) {
+                release_unused(buffers, plan);
+                vector<pair<int,int>> result = solve(job.chords, plan, buffers);
+                reply = job.binary ? binary_response(result) : text_response(result);
+            } else {
+                reply = error_response(job.binary, why);
+            }
+            Clock::time_point solved = Clock::now();
+            job.conn->deliver(job.seq, move(reply));
+            stats_.record(micros(begin - job.arrived), micros(solved - begin),
+                          micros(Clock::now() - job.arrived), why.empty());
+        }
+    }
+
+    struct Handler {
+        weak_ptr<Connection> conn;  // closes once the handler and its jobs are done
+        std::thread thread;
+        shared_ptr<atomic<bool>> done;
+    };
+
+    int workers_;
+    unsigned long long budget_;
+    vector<pthread_t> workerIds_;
+    list<Handler> handlers_;  // touched by the accept loop only
+    mutex mu_;
+    condition_variable notEmpty_, notFull_;
+    deque<Job> queue_;
+    bool closing_ = false;
+    Stats stats_;
+};
+
+} // namespace
+
+int serve(const string& socketPath, int workers, unsigned long long memLimit) {
+    if (workers <= 0) workers = max(1u, thread::hardware_concurrency());
+    if (memLimit == 0) memLimit = available_memory();
+    if (memLimit == 0) {
+        cerr << "mps: cannot read MemAvailable from /proc/meminfo, pass --mem-limit\n";
+        return 1;
+    }
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << "mps: socket path too long\n";
+        return 1;
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socketPath.c_str());  // stale socket from an earlier run
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0 || bind(lfd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(lfd, 64) < 0) {
+        cerr << "mps: cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    Server server(workers, memLimit);
+    if (!server.start()) {
+        cerr << "mps: cannot start worker threads\n";
+        return 1;
+    }
+    cerr << "[serve] " << socketPath << " workers=" << workers
+         << " budget/worker=" << (memLimit / workers >> 20) << "MiB\n";
+
+    while (!stopping) {
+        pollfd p{lfd, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0) continue;
+        int fd = accept(lfd, nullptr, nullptr);
+        if (fd < 0) continue;
+        server.accept_connection(fd);
+    }
+
+    close(lfd);
+    server.stop();
+    unlink(socketPath.c_str());
+    cerr << server.stats().report();
+    return 0;
+}
@@ -0,0 +1,8 @@
+#!/bin/bash
+# Unidirectional vs bidirectional A* on the long nets of case3-case6.
+# Extra arguments (e.g. --min-span 100, --layout padded) are passed to every run.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+for i in 3 4 5 6; do
+    ./bin/bidir_bench --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" "$@" || exit 1
+done
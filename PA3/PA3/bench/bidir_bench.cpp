@@ -0,0 +1,119 @@
+// bidir_bench.cpp
+// Unidirectional vs bidirectional A* on the long nets of a case.
+//
+//   bin/bidir_bench --cap inputs/case4.cap --net inputs/case4.net [--min-span N]
+//                   [--layout dense|padded|tiled]
+//
+// All nets are first routed once in input order (like the router's first
+// iteration) so the searches run against realistic congestion costs.  Then
+// every net spanning at least --min-span gcells (default: a quarter of
+// xSize + ySize) is searched both ways under the same costs.  The two costs
+// must match; the report gives time and vertices touched for each.
+#include "graph.h"
+#include "parser.h"
+#include "router.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int pinIndex(const Grid &grid, const Coord3D &c) {
+    return grid.gcellIndex(c.layer, c.col, c.row);
+}
+
+int spanOf(const Net &net) {
+    return std::abs(net.pin1.col - net.pin2.col) + std::abs(net.pin1.row - net.pin2.row);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string capFile, netFile;
+    int minSpan = -1;
+    GridLayout layout = GridLayout::Dense;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cap") capFile = argv[++i];
+        else if (opt == "--net") netFile = argv[++i];
+        else if (opt == "--min-span") minSpan = std::atoi(argv[++i]);
+        else if (opt == "--layout") {
+            const std::string val = argv[++i];
+            layout = val == "padded" ? GridLayout::Padded
+                   : val == "tiled" ? GridLayout::Tiled : GridLayout::Dense;
+        }
+    }
+    if (capFile.empty() || netFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --cap case.cap --net case.net [--min-span N]"
+                  << " [--layout dense|padded|tiled]\n";
+        return 1;
+    }
+
+    ParsedInput input;
+    if (!parseInputFiles(capFile, netFile, input)) {
+        std::cerr << "Error: failed to parse input files.\n";
+        return 1;
+    }
+    Grid &grid = input.grid;
+    grid.setLayout(layout);
+    if (minSpan < 0) minSpan = (grid.xSize() + grid.ySize()) / 4;
+
+    GridGraph graph(grid);
+    SearchWorkspace fwd, bwd;
+
+    // congestion from one in-order pass
+    grid.resetDemand();
+    for (size_t n = 0; n < input.nets.size(); ++n) {
+        const Net &net = input.nets[n];
+        int src = pinIndex(grid, net.pin1), dst = pinIndex(grid, net.pin2);
+        if (astar(graph, grid, src, dst, computeVertexCost(grid), fwd) >= INF) continue;
+        for (int v = dst; v != -1; v = fwd.prev(v)) {
+            Coord3D c = grid.fromIndex(v);
+            grid.addDemandForNetGCell(static_cast<int>(n), c.layer, c.col, c.row);
+        }
+    }
+    const std::vector<long long> costs = computeVertexCost(grid);
+    bwd.begin(graph.numVertices());  // size it outside the timed region
+
+    int count = 0, mismatches = 0;
+    long long uniTouched = 0, biTouched = 0;
+    double uniTime = 0, biTime = 0;
+    for (const Net &net : input.nets) {
+        if (spanOf(net) < minSpan) continue;
+        int src = pinIndex(grid, net.pin1), dst = pinIndex(grid, net.pin2);
+
+        auto t0 = std::chrono::steady_clock::now();
+        long long uni = astar(graph, grid, src, dst, costs, fwd);
+        uniTime += secondsSince(t0);
+        uniTouched += static_cast<long long>(fwd.touched().size());
+
+        int meet = -1;
+        t0 = std::chrono::steady_clock::now();
+        long long bi = bidirectionalAstar(graph, grid, src, dst, costs, fwd, bwd, meet);
+        biTime += secondsSince(t0);
+        biTouched += static_cast<long long>(fwd.touched().size() + bwd.touched().size());
+
+        ++count;
+        if (uni != bi) {
+            ++mismatches;
+            std::cerr << "cost mismatch on " << net.name << ": " << uni << " vs " << bi << "\n";
+        }
+    }
+
+    std::cout << capFile << ": " << count << " nets with span >= " << minSpan
+              << " (grid " << grid.xSize() << "x" << grid.ySize() << ")\n";
+    if (count == 0) return 0;
+    std::cout << std::fixed << std::setprecision(2)
+              << "  unidirectional  " << std::setw(9) << uniTime * 1e3 << " ms  "
+              << std::setw(10) << uniTouched / count << " touched/net\n"
+              << "  bidirectional   " << std::setw(9) << biTime * 1e3 << " ms  "
+              << std::setw(10) << biTouched / count << " touched/net\n"
+              << "  cost mismatches " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,8 @@
+#!/bin/bash
+# Full-grid cost refresh: old per-cell loop vs table-driven scalar and AVX2
+# kernels, at the size of case4 and on a 16M-cell grid.  Extra arguments
+# (e.g. --reps 50) are passed to every run.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+./bin/cost_bench "$@" || exit 1
+./bin/cost_bench --cells 16777216 "$@" || exit 1
@@ -0,0 +1,92 @@
+// cost_bench.cpp
+// Full-grid cost refresh: the per-cell loop it replaced, the table-driven
+// scalar kernel and the AVX2 kernel.
+//
+//   bin/cost_bench [--cells N] [--reps R]
+//
+// Demand, capacity and history are random over N cells (default 2 x 619 x
+// 613, the size of case4).  Each version runs R times (default 20) and the
+// best time counts; bandwidth counts the 24 bytes read and written per
+// cell.  All three must produce the same costs.
+#include "costmap.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// the refresh before the kernel, kept as the reference
+long long referenceCost(int demand, int capacity) {
+    const long long baseCost = 100000;
+    const long long alpha = 1000;
+    int overflow = std::min(20, std::max(0, demand - capacity));
+    long long cost = alpha * ((1 << overflow) - 1);
+    if (overflow > 0) cost += baseCost;
+    return cost;
+}
+
+template <typename Refresh>
+double bestOf(int reps, Refresh refresh) {
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        refresh();
+        best = std::min(best, secondsSince(t0));
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    int cells = 2 * 619 * 613, reps = 20;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cells") cells = std::max(1, std::atoi(argv[++i]));
+        else if (opt == "--reps") reps = std::max(1, std::atoi(argv[++i]));
+    }
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> demand(0, 40), capacity(0, 12), history(0, 50);
+    std::vector<int> d(cells), c(cells);
+    std::vector<long long> h(cells);
+    for (int i = 0; i < cells; ++i) {
+        d[i] = demand(rng);
+        c[i] = capacity(rng);
+        h[i] = history(rng);
+    }
+    const long long beta = 1000;
+    std::vector<long long> ref(cells), scalar(cells), simd(cells);
+
+    const double tr = bestOf(reps, [&] {
+        for (int i = 0; i < cells; ++i) ref[i] = referenceCost(d[i], c[i]) + beta * h[i];
+    });
+    const double ts = bestOf(reps, [&] {
+        congestionCosts(d.data(), c.data(), h.data(), beta, scalar.data(), cells, false);
+    });
+    const double tv = bestOf(reps, [&] {
+        congestionCosts(d.data(), c.data(), h.data(), beta, simd.data(), cells, true);
+    });
+
+    const double gb = 24.0 * cells / 1e9;
+    std::cout << std::fixed << std::setprecision(2) << cells << " cells\n"
+              << "  per-cell loop  " << std::setw(9) << tr * 1e3 << " ms  " << std::setw(6)
+              << gb / tr << " GB/s\n"
+              << "  table scalar   " << std::setw(9) << ts * 1e3 << " ms  " << std::setw(6)
+              << gb / ts << " GB/s\n"
+              << "  table " << (congestionCostsHaveSimd() ? "AVX2     " : "(no AVX2)")
+              << std::setw(9) << tv * 1e3 << " ms  " << std::setw(6) << gb / tv << " GB/s\n";
+    if (ref != scalar || ref != simd) {
+        std::cout << "  costs differ from the reference loop\n";
+        return 2;
+    }
+    return 0;
+}
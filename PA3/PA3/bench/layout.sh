@@ -0,0 +1,9 @@
+#!/bin/bash
+# A* on the dense, padded and tiled layouts on case3-case6: time and cache
+# lines touched per search.  Extra arguments (e.g. --min-span 50) are passed
+# to every run.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+for i in 3 4 5 6; do
+    ./bin/layout_bench --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" "$@" || exit 1
+done
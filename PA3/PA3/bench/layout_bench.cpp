@@ -0,0 +1,132 @@
+// layout_bench.cpp
+// A* over the dense, padded and tiled gcell layouts, under the same costs.
+//
+//   bin/layout_bench --cap inputs/case4.cap --net inputs/case4.net [--min-span N] [--reps R]
+//
+// The nets are routed once in input order on the dense layout (like the
+// router's first iteration) and those paths are replayed as demand on each
+// layout.  Then every net spanning at least --min-span gcells (default 0)
+// is searched R times (default 3, the best pass counts).  The path costs
+// must be the same on every layout.  Besides the time, the report counts
+// the distinct 64-byte lines a search touches, in the cost array (8 bytes
+// per gcell) and in the search state (g, f, prev and stamp, 8 + 8 + 4 + 4
+// bytes in four arrays).
+#include "graph.h"
+#include "parser.h"
+#include "router.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int spanOf(const Net &net) {
+    return std::abs(net.pin1.col - net.pin2.col) + std::abs(net.pin1.row - net.pin2.row);
+}
+
+// distinct lines among the elements v of an array of elemBytes-sized
+// elements, for v in touched; lines is scratch
+long long linesOf(const std::vector<int> &touched, int elemBytes, std::vector<long long> &lines) {
+    lines.clear();
+    for (int v : touched) lines.push_back(static_cast<long long>(v) * elemBytes / 64);
+    std::sort(lines.begin(), lines.end());
+    return std::unique(lines.begin(), lines.end()) - lines.begin();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string capFile, netFile;
+    int minSpan = 0, reps = 3;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cap") capFile = argv[++i];
+        else if (opt == "--net") netFile = argv[++i];
+        else if (opt == "--min-span") minSpan = std::atoi(argv[++i]);
+        else if (opt == "--reps") reps = std::max(1, std::atoi(argv[++i]));
+    }
+    if (capFile.empty() || netFile.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --cap case.cap --net case.net [--min-span N] [--reps R]\n";
+        return 1;
+    }
+
+    ParsedInput input;
+    if (!parseInputFiles(capFile, netFile, input)) {
+        std::cerr << "Error: failed to parse input files.\n";
+        return 1;
+    }
+    Grid &grid = input.grid;
+    const std::vector<Net> &nets = input.nets;
+    SearchWorkspace ws;
+
+    // congestion from one in-order pass on the dense layout
+    std::vector<std::vector<Coord3D>> paths(nets.size());
+    {
+        GridGraph graph(grid);
+        for (size_t n = 0; n < nets.size(); ++n) {
+            const int src = grid.gcellIndex(nets[n].pin1.layer, nets[n].pin1.col, nets[n].pin1.row);
+            const int dst = grid.gcellIndex(nets[n].pin2.layer, nets[n].pin2.col, nets[n].pin2.row);
+            if (astar(graph, grid, src, dst, computeVertexCost(grid), ws) >= INF) continue;
+            for (int v = dst; v != -1; v = ws.prev(v)) paths[n].push_back(grid.coordOf(v));
+            grid.addPathDemand(static_cast<int>(n), paths[n]);
+        }
+    }
+
+    std::cout << capFile << ": grid " << grid.xSize() << "x" << grid.ySize() << "\n"
+              << "  layout      ms/search   touched  cost lines  state lines\n";
+    std::vector<long long> reference, lines;
+    int mismatches = 0;
+    const std::pair<const char *, GridLayout> layouts[] = {
+        {"dense", GridLayout::Dense}, {"padded", GridLayout::Padded}, {"tiled", GridLayout::Tiled}};
+    for (const auto &[name, layout] : layouts) {
+        grid.setLayout(layout);
+        for (size_t n = 0; n < nets.size(); ++n) grid.addPathDemand(static_cast<int>(n), paths[n]);
+        const std::vector<long long> costs = computeVertexCost(grid);
+        GridGraph graph(grid);
+        ws.begin(graph.numVertices());  // size it outside the timed region
+
+        double best = 1e30;
+        long long searches = 0, touched = 0, costLines = 0, stateLines = 0;
+        std::vector<long long> results;
+        for (int rep = 0; rep < reps; ++rep) {
+            double time = 0;
+            for (const Net &net : nets) {
+                if (spanOf(net) < minSpan) continue;
+                const int src = grid.indexOf(net.pin1.layer, net.pin1.col, net.pin1.row);
+                const int dst = grid.indexOf(net.pin2.layer, net.pin2.col, net.pin2.row);
+                const auto t0 = std::chrono::steady_clock::now();
+                const long long cost = astar(graph, grid, src, dst, costs, ws);
+                time += secondsSince(t0);
+                if (rep > 0) continue;
+                results.push_back(cost);
+                ++searches;
+                touched += static_cast<long long>(ws.touched().size());
+                const long long wordLines = linesOf(ws.touched(), 8, lines);
+                costLines += wordLines;
+                stateLines += 2 * wordLines + 2 * linesOf(ws.touched(), 4, lines);
+            }
+            best = std::min(best, time);
+        }
+        if (reference.empty()) reference = results;
+        else if (results != reference) ++mismatches;
+        if (searches == 0) break;
+
+        std::cout << std::fixed << std::setprecision(3) << "  " << std::left << std::setw(8) << name
+                  << std::right << std::setw(11) << best * 1e3 / searches
+                  << std::setw(10) << touched / searches << std::setw(12) << costLines / searches
+                  << std::setw(13) << stateLines / searches << "\n";
+    }
+    if (mismatches) {
+        std::cout << "  path costs differ between layouts\n";
+        return 2;
+    }
+    return 0;
+}
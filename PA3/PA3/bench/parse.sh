@@ -0,0 +1,12 @@
+#!/bin/bash
+# parseInputFiles() vs the old ifstream parser: case4-case6, then a generated
+# 2000x2000 grid with two million nets.  Extra arguments (e.g. --threads 8)
+# are passed to every run.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+for i in 4 5 6; do
+    ./bin/parse_bench --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" "$@" || exit 1
+done
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+./bin/parse_bench --size 2000 --nets 2000000 --dir "$tmp" "$@" || exit 1
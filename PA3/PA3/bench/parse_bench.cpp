@@ -0,0 +1,257 @@
+// parse_bench.cpp
+// parseInputFiles() against the ifstream/istringstream parser it replaced.
+//
+//   bin/parse_bench --cap case.cap --net case.net [--threads T]
+//   bin/parse_bench --size S --nets N [--threads T] [--dir D]   a generated case
+//
+// The generated case is an S x S grid with N two-pin nets, written to D and
+// removed afterwards.  Each parser runs three times and the best time
+// counts; the grids and net lists must come out the same.
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// the parser before the mapped one, kept as the reference
+namespace reference {
+
+std::string trim(const std::string &s) {
+    size_t b = 0;
+    while (b < s.size() && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+    size_t e = s.size();
+    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+    return s.substr(b, e - b);
+}
+
+bool parseCoordLine(const std::string &line, Coord3D &coord) {
+    std::istringstream iss(line);
+    char ch;
+    if (!(iss >> ch) || ch != '(') return false;
+    if (!(iss >> coord.layer)) return false;
+    if (!(iss >> ch) || ch != ',') return false;
+    if (!(iss >> coord.col)) return false;
+    if (!(iss >> ch) || ch != ',') return false;
+    if (!(iss >> coord.row)) return false;
+    if (!(iss >> ch) || ch != ')') return false;
+    return true;
+}
+
+bool readNonEmptyLine(std::ifstream &fin, std::string &out) {
+    while (std::getline(fin, out)) {
+        std::string t = trim(out);
+        if (!t.empty()) {
+            out = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseCapFile(const std::string &filename, Grid &grid) {
+    std::ifstream fin(filename);
+    if (!fin) return false;
+    int numLayers = 0, xSize = 0, ySize = 0;
+    if (!(fin >> numLayers >> xSize >> ySize)) return false;
+    if (numLayers != 2) return false;
+    grid.resize(xSize, ySize);
+    int viaCost = 0;
+    if (!(fin >> viaCost)) return false;
+    grid.setViaCost(viaCost);
+    std::vector<int> horizontal(std::max(0, xSize - 1));
+    for (int j = 0; j < xSize - 1; ++j)
+        if (!(fin >> horizontal[j])) return false;
+    grid.setHorizontalDistances(horizontal);
+    std::vector<int> vertical(std::max(0, ySize - 1));
+    for (int i = 0; i < ySize - 1; ++i)
+        if (!(fin >> vertical[i])) return false;
+    grid.setVerticalDistances(vertical);
+    for (int l = 0; l < numLayers; ++l) {
+        std::string layerName, dir;
+        if (!(fin >> layerName >> dir)) return false;
+        grid.setLayerInfo(l, LayerInfo{layerName, dir.empty() ? 'H' : dir[0]});
+        for (int row = 0; row < ySize; ++row) {
+            for (int col = 0; col < xSize; ++col) {
+                int cap = 0;
+                if (!(fin >> cap)) return false;
+                grid.setCapacity(l, col, row, cap);
+            }
+        }
+    }
+    grid.resetDemand();
+    return true;
+}
+
+bool parseNetFile(const std::string &filename, std::vector<Net> &nets) {
+    std::ifstream fin(filename);
+    if (!fin) return false;
+    std::string line;
+    while (readNonEmptyLine(fin, line)) {
+        if (!line.empty() && line[0] == '#') continue;
+        Net net;
+        net.name = line;
+        if (!readNonEmptyLine(fin, line) || line.find('(') == std::string::npos) return false;
+        Coord3D pins[2];
+        for (int idx = 0; idx < 2; ++idx)
+            if (!readNonEmptyLine(fin, line) || !parseCoordLine(line, pins[idx])) return false;
+        if (!readNonEmptyLine(fin, line) || line.find(')') == std::string::npos) return false;
+        net.pin1 = pins[0];
+        net.pin2 = pins[1];
+        nets.push_back(net);
+    }
+    return true;
+}
+
+} // namespace reference
+
+bool generate(const std::string &capFile, const std::string &netFile, int size, long long nets) {
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> coord(0, size - 1), cap(0, 12), dist(1000, 9000);
+    std::ofstream cap_out(capFile), net_out(netFile);
+    cap_out << "2 " << size << " " << size << "\n100\n";
+    for (int k = 0; k < 2; ++k) {
+        for (int j = 0; j + 1 < size; ++j) cap_out << (j ? " " : "") << dist(rng);
+        cap_out << "\n";
+    }
+    for (int l = 0; l < 2; ++l) {
+        cap_out << "Metal" << l + 1 << (l ? " V" : " H") << "\n";
+        for (int i = 0; i < size; ++i) {
+            for (int j = 0; j < size; ++j) cap_out << (j ? " " : "") << cap(rng);
+            cap_out << "\n";
+        }
+    }
+    for (long long n = 0; n < nets; ++n) {
+        net_out << "net" << n << "\n(\n";
+        for (int p = 0; p < 2; ++p)
+            net_out << "(" << (coord(rng) & 1) << ", " << coord(rng) << ", " << coord(rng) << ")\n";
+        net_out << ")\n";
+    }
+    return static_cast<bool>(cap_out) && static_cast<bool>(net_out);
+}
+
+bool sameInput(const ParsedInput &a, const ParsedInput &b) {
+    const Grid &g = a.grid, &h = b.grid;
+    if (g.xSize() != h.xSize() || g.ySize() != h.ySize() || g.wlViaCost() != h.wlViaCost())
+        return false;
+    for (int j = 0; j + 1 < g.xSize(); ++j)
+        if (g.horizontalDist(j) != h.horizontalDist(j)) return false;
+    for (int i = 0; i + 1 < g.ySize(); ++i)
+        if (g.verticalDist(i) != h.verticalDist(i)) return false;
+    for (int l = 0; l < g.numLayers(); ++l) {
+        if (g.layerInfo(l).name != h.layerInfo(l).name ||
+            g.layerInfo(l).direction != h.layerInfo(l).direction)
+            return false;
+        for (int i = 0; i < g.ySize(); ++i)
+            for (int j = 0; j < g.xSize(); ++j)
+                if (g.capacity(l, j, i) != h.capacity(l, j, i)) return false;
+    }
+    if (a.nets.size() != b.nets.size()) return false;
+    auto same = [](const Coord3D &p, const Coord3D &q) {
+        return p.layer == q.layer && p.col == q.col && p.row == q.row;
+    };
+    for (size_t n = 0; n < a.nets.size(); ++n) {
+        const Net &x = a.nets[n], &y = b.nets[n];
+        if (x.name != y.name || !same(x.pin1, y.pin1) || !same(x.pin2, y.pin2)) return false;
+    }
+    return true;
+}
+
+template <typename Parse>
+double bestOf3(Parse parse, ParsedInput &out) {
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep) {
+        ParsedInput input;
+        auto t0 = std::chrono::steady_clock::now();
+        if (!parse(input)) return -1;
+        best = std::min(best, secondsSince(t0));
+        out = std::move(input);
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string capFile, netFile, dir = "/tmp";
+    int size = 0;
+    long long nets = 0;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cap") capFile = argv[++i];
+        else if (opt == "--net") netFile = argv[++i];
+        else if (opt == "--size") size = std::atoi(argv[++i]);
+        else if (opt == "--nets") nets = std::atoll(argv[++i]);
+        else if (opt == "--threads") threads = std::max(1, std::atoi(argv[++i]));
+        else if (opt == "--dir") dir = argv[++i];
+    }
+
+    std::string label;
+    bool generated = false;
+    if (!capFile.empty() && !netFile.empty()) {
+        label = netFile;
+    } else if (size > 1 && nets > 0) {
+        capFile = dir + "/parse_bench.cap";
+        netFile = dir + "/parse_bench.net";
+        generated = true;
+        if (!generate(capFile, netFile, size, nets)) {
+            std::cerr << "Error: cannot write to " << dir << "\n";
+            return 1;
+        }
+        label = "generated " + std::to_string(size) + "x" + std::to_string(size) + ", " +
+                std::to_string(nets) + " nets";
+    } else {
+        std::cerr << "Usage: " << argv[0] << " (--cap case.cap --net case.net | --size S --nets N)"
+                  << " [--threads T] [--dir D]\n";
+        return 1;
+    }
+
+    ParsedInput ref, one, many;
+    const double tr = bestOf3([&](ParsedInput &in) {
+        return reference::parseCapFile(capFile, in.grid) && reference::parseNetFile(netFile, in.nets);
+    }, ref);
+    const double t1 = bestOf3([&](ParsedInput &in) {
+        return parseInputFiles(capFile, netFile, in, 1);
+    }, one);
+    const double tt = bestOf3([&](ParsedInput &in) {
+        return parseInputFiles(capFile, netFile, in, threads);
+    }, many);
+    std::ifstream capIn(capFile, std::ios::ate), netIn(netFile, std::ios::ate);
+    const double mb = (static_cast<double>(capIn.tellg()) + static_cast<double>(netIn.tellg())) / 1e6;
+    if (generated) {
+        std::remove(capFile.c_str());
+        std::remove(netFile.c_str());
+    }
+    if (tr < 0 || t1 < 0 || tt < 0) {
+        std::cerr << "Error: cannot parse " << capFile << " / " << netFile << "\n";
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << label << ": " << mb << " MB, " << ref.nets.size() << " nets\n"
+              << "  ifstream            " << std::setw(8) << tr * 1e3 << " ms  "
+              << std::setw(7) << mb / tr << " MB/s\n"
+              << "  parseInputFiles x1  " << std::setw(8) << t1 * 1e3 << " ms  "
+              << std::setw(7) << mb / t1 << " MB/s\n"
+              << "  parseInputFiles x" << std::left << std::setw(3) << threads << std::right
+              << std::setw(8) << tt * 1e3 << " ms  " << std::setw(7) << mb / tt << " MB/s\n";
+    if (!sameInput(ref, one) || !sameInput(ref, many)) {
+        std::cout << "  input differs from the reference parser\n";
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+#!/bin/bash
+# BinaryHeap vs RadixHeap: the bare queue, then astar/dijkstra on case3-case6.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+./bin/queue_bench "$@" || exit 1
+for i in 3 4 5 6; do
+    ./bin/queue_bench --ops 0 --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" || exit 1
+done
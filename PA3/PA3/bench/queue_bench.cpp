@@ -0,0 +1,161 @@
+// queue_bench.cpp
+// BinaryHeap vs RadixHeap (pqueue.h), as a bare queue and inside the searches.
+//
+//   bin/queue_bench [--ops N]                               micro benchmark only
+//   bin/queue_bench --cap case.cap --net case.net [--ops N] plus the searches
+//
+// The micro benchmark replays one monotone workload (each popped key is a
+// lower bound for the keys pushed after it, three pushes per pop on average)
+// on both queues and checks that they pop the same key sequence.  The search
+// part routes every net once in input order to get congestion costs, then
+// times astar() on every net and dijkstra() from a few sources with each
+// queue, and checks that the costs match.
+#include "graph.h"
+#include "parser.h"
+#include "pqueue.h"
+#include "router.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+int pinIndex(const Grid &grid, const Coord3D &c) {
+    return grid.gcellIndex(c.layer, c.col, c.row);
+}
+
+// pushes/pops on q, returns a checksum of the popped key sequence
+template <typename QueueT>
+unsigned long long replay(QueueT &q, long long ops, int numVertices, double &seconds) {
+    std::mt19937_64 rng(12345);
+    std::uniform_int_distribution<long long> step(0, 6000);
+    std::uniform_int_distribution<int> vertex(0, numVertices - 1);
+    unsigned long long checksum = 0;
+    long long last = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    q.reset(numVertices);
+    for (long long i = 0; i < ops; ++i) {
+        if (i % 4 != 3 || q.empty()) {
+            q.push(last + step(rng), vertex(rng));
+        } else {
+            last = q.pop().first;
+            checksum = checksum * 1000003 + static_cast<unsigned long long>(last);
+        }
+    }
+    while (!q.empty()) checksum = checksum * 1000003 + static_cast<unsigned long long>(q.pop().first);
+    seconds = secondsSince(t0);
+    return checksum;
+}
+
+template <typename QueueT>
+long long searchAll(const Grid &grid, const std::vector<Net> &nets,
+                    const std::vector<long long> &costs, SearchWorkspace &ws,
+                    std::vector<long long> &out, double &seconds) {
+    GridGraph graph(grid);
+    long long touched = 0;
+    out.clear();
+    auto t0 = std::chrono::steady_clock::now();
+    for (const Net &net : nets) {
+        out.push_back(astar<GridGraph, QueueT>(
+            graph, grid, pinIndex(grid, net.pin1), pinIndex(grid, net.pin2), costs, ws));
+        touched += static_cast<long long>(ws.touched().size());
+    }
+    seconds = secondsSince(t0);
+    return touched;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string capFile, netFile;
+    long long ops = 20000000;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cap") capFile = argv[++i];
+        else if (opt == "--net") netFile = argv[++i];
+        else if (opt == "--ops") ops = std::atoll(argv[++i]);
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    int status = 0;
+
+    if (ops > 0) {
+        BinaryHeap binary;
+        RadixHeap radix;
+        double tb = 0, tr = 0;
+        unsigned long long cb = replay(binary, ops, 1 << 20, tb);
+        unsigned long long cr = replay(radix, ops, 1 << 20, tr);
+        std::cout << "micro: " << ops << " ops\n"
+                  << "  binary heap  " << std::setw(9) << tb * 1e9 / ops << " ns/op\n"
+                  << "  radix heap   " << std::setw(9) << tr * 1e9 / ops << " ns/op\n";
+        if (cb != cr) {
+            std::cout << "  popped key sequences differ\n";
+            status = 2;
+        }
+    }
+    if (capFile.empty() || netFile.empty()) return status;
+
+    ParsedInput input;
+    if (!parseInputFiles(capFile, netFile, input)) {
+        std::cerr << "Error: failed to parse input files.\n";
+        return 1;
+    }
+    Grid &grid = input.grid;
+    GridGraph graph(grid);
+    SearchWorkspace ws;
+
+    // congestion from one in-order pass
+    grid.resetDemand();
+    for (size_t n = 0; n < input.nets.size(); ++n) {
+        const Net &net = input.nets[n];
+        int src = pinIndex(grid, net.pin1), dst = pinIndex(grid, net.pin2);
+        if (astar(graph, grid, src, dst, computeVertexCost(grid), ws) >= INF) continue;
+        for (int v = dst; v != -1; v = ws.prev(v)) {
+            Coord3D c = grid.fromIndex(v);
+            grid.addDemandForNetGCell(static_cast<int>(n), c.layer, c.col, c.row);
+        }
+    }
+    std::vector<long long> costs = computeVertexCost(grid);
+
+    std::vector<long long> costB, costR;
+    double tb = 0, tr = 0;
+    long long touched = searchAll<BinaryHeap>(grid, input.nets, costs, ws, costB, tb);
+    searchAll<RadixHeap>(grid, input.nets, costs, ws, costR, tr);
+    std::cout << capFile << ": astar on " << input.nets.size() << " nets, "
+              << touched / static_cast<long long>(input.nets.size()) << " touched/net\n"
+              << "  binary heap  " << std::setw(9) << tb * 1e3 << " ms\n"
+              << "  radix heap   " << std::setw(9) << tr * 1e3 << " ms\n";
+    if (costB != costR) {
+        std::cout << "  path costs differ\n";
+        status = 2;
+    }
+
+    Graph g = buildGraphFromGrid(grid);
+    const int sources = 4;
+    tb = tr = 0;
+    bool same = true;
+    for (int k = 0; k < sources; ++k) {
+        int src = static_cast<int>(static_cast<long long>(g.numVertices()) * k / sources);
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<long long> db = dijkstra<BinaryHeap>(g, src, costs);
+        tb += secondsSince(t0);
+        t0 = std::chrono::steady_clock::now();
+        std::vector<long long> dr = dijkstra<RadixHeap>(g, src, costs);
+        tr += secondsSince(t0);
+        same = same && db == dr;
+    }
+    std::cout << "  dijkstra from " << sources << " sources, " << g.numVertices() << " vertices\n"
+              << "  binary heap  " << std::setw(9) << tb * 1e3 << " ms\n"
+              << "  radix heap   " << std::setw(9) << tr * 1e3 << " ms\n";
+    if (!same) {
+        std::cout << "  distances differ\n";
+        status = 2;
+    }
+    return status;
+}
@@ -0,0 +1,9 @@
+#!/bin/bash
+# Fixed vs negotiated congestion cost schedule on case1-case6: least
+# overflow, when it was reached, and the wire cost.  Extra arguments (e.g.
+# --budget 30, --seed 3) are passed to every run; the router log is dropped.
+cd "$(dirname "$0")/.." || exit 1
+make bench > /dev/null || exit 1
+for i in 1 2 3 4 5 6; do
+    ./bin/schedule_bench --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" "$@" 2> /dev/null || exit 1
+done
@@ -0,0 +1,66 @@
+// schedule_bench.cpp
+// The fixed and the negotiated congestion cost schedules on one case.
+//
+//   bin/schedule_bench --cap inputs/case5.cap --net inputs/case5.net [--budget S] [--seed N]
+//
+// The router runs once per schedule with the same seed, one thread and a
+// time budget of S seconds (default 60).  From the convergence log the
+// report gives the least overflow the run reached, the first iteration that
+// reached it and the time that took, and the wire cost (wire length plus
+// vias times the via cost) of the result.  The router's own log goes to
+// stderr.
+#include "parser.h"
+#include "router.h"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+int main(int argc, char **argv) {
+    std::string capFile, netFile;
+    double budget = 60;
+    unsigned seed = 7;
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--cap") capFile = argv[++i];
+        else if (opt == "--net") netFile = argv[++i];
+        else if (opt == "--budget") budget = std::atof(argv[++i]);
+        else if (opt == "--seed") seed = static_cast<unsigned>(std::atoi(argv[++i]));
+    }
+    if (capFile.empty() || netFile.empty() || budget <= 0 || seed == 0) {
+        std::cerr << "Usage: " << argv[0] << " --cap case.cap --net case.net [--budget S] [--seed N]\n";
+        return 1;
+    }
+
+    ParsedInput input;
+    if (!parseInputFiles(capFile, netFile, input)) {
+        std::cerr << "Error: failed to parse input files.\n";
+        return 1;
+    }
+
+    std::cout << capFile << ": " << input.nets.size() << " nets, budget " << budget << " s\n"
+              << "  schedule     overflow  at iter  seconds   iterations      wire cost\n";
+    const std::pair<const char *, CostSchedule> schedules[] = {
+        {"fixed", CostSchedule::Fixed}, {"negotiated", CostSchedule::Negotiated}};
+    for (const auto &[name, schedule] : schedules) {
+        RouterOptions options;
+        options.schedule = schedule;
+        options.seed = seed;
+        options.timeBudget = budget;
+        Grid grid = input.grid;
+        const RoutingResult result = runRouting(grid, input.nets, options);
+        if (result.convergence.empty()) {
+            std::cerr << "Error: no iteration finished\n";
+            return 1;
+        }
+
+        const IterationStats *best = &result.convergence[0];
+        for (const IterationStats &st : result.convergence)
+            if (st.overflow < best->overflow) best = &st;
+        std::cout << std::fixed << std::setprecision(2) << "  " << std::left << std::setw(11) << name
+                  << std::right << std::setw(9) << best->overflow << std::setw(9) << best->iter
+                  << std::setw(9) << best->seconds << std::setw(13) << result.convergence.size()
+                  << std::setw(15) << result.wirelength + result.vias * grid.wlViaCost() << "\n";
+    }
+    return 0;
+}
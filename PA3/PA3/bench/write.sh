@@ -0,0 +1,14 @@
+#!/bin/bash
+# writeRouteFile() vs the old ofstream writer: the routes of case5 and case6
+# (routed with a short time budget), then a synthetic million-net result.
+# Extra arguments (e.g. --threads 8) are passed to every run.
+cd "$(dirname "$0")/.." || exit 1
+make all bench > /dev/null || exit 1
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+for i in 5 6; do
+    ./bin/pa3 --cap "inputs/case${i}.cap" --net "inputs/case${i}.net" --out "$tmp/case${i}.route" \
+        --time-budget 20 2> /dev/null || exit 1
+    ./bin/write_bench --route "$tmp/case${i}.route" --dir "$tmp" "$@" || exit 1
+done
+./bin/write_bench --nets 1000000 --dir "$tmp" "$@" || exit 1
@@ -0,0 +1,162 @@
+// write_bench.cpp
+// writeRouteFile() against the plain std::ofstream writer it replaced.
+//
+//   bin/write_bench --route case.route [--threads T] [--dir D]   a real result
+//   bin/write_bench --nets N [--segs K] [--threads T] [--dir D]  a synthetic one
+//
+// The synthetic result has N nets of K segments (default 12, about what
+// the merged case5/case6 routes average) with random coordinates.  Each
+// writer runs three times and the best time counts; the files are
+// compared byte for byte against the reference writer's.
+#include "router.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// the writer before the chunked one, kept as the reference
+bool writeReference(const std::string &filename, const RoutingResult &result) {
+    std::ofstream fout(filename);
+    if (!fout) return false;
+    for (const RoutedNet &net : result.nets) {
+        fout << net.name << "\n";
+        fout << "(\n";
+        for (const Segment &seg : net.segments) {
+            fout << seg.from.layer << " " << seg.from.col << " " << seg.from.row << " "
+                 << seg.to.layer << " " << seg.to.col << " " << seg.to.row << "\n";
+        }
+        fout << ")\n";
+    }
+    return static_cast<bool>(fout);
+}
+
+bool loadRoute(const std::string &filename, RoutingResult &result) {
+    std::ifstream fin(filename);
+    if (!fin) return false;
+    std::string line;
+    while (std::getline(fin, line)) {
+        if (line.empty() || line == "(" || line == ")") continue;
+        RoutedNet net;
+        net.name = line;
+        while (std::getline(fin, line) && line != ")") {
+            if (line == "(") continue;
+            std::istringstream in(line);
+            Segment seg;
+            if (in >> seg.from.layer >> seg.from.col >> seg.from.row >> seg.to.layer >> seg.to.col >> seg.to.row)
+                net.segments.push_back(seg);
+        }
+        result.nets.push_back(std::move(net));
+    }
+    return true;
+}
+
+RoutingResult synthetic(long long nets, int segs) {
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> coord(0, 999);
+    RoutingResult result;
+    result.nets.resize(nets);
+    for (long long n = 0; n < nets; ++n) {
+        RoutedNet &net = result.nets[n];
+        net.name = "net" + std::to_string(n);
+        net.segments.resize(segs);
+        for (Segment &seg : net.segments) {
+            seg.from = Coord3D{coord(rng) & 1, coord(rng), coord(rng)};
+            seg.to = Coord3D{coord(rng) & 1, coord(rng), coord(rng)};
+        }
+    }
+    return result;
+}
+
+std::string slurp(const std::string &filename) {
+    std::ifstream fin(filename, std::ios::binary);
+    std::ostringstream ss;
+    ss << fin.rdbuf();
+    return ss.str();
+}
+
+template <typename Write>
+double bestOf3(Write write) {
+    double best = 1e30;
+    for (int rep = 0; rep < 3; ++rep) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (!write()) return -1;
+        best = std::min(best, secondsSince(t0));
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string routeFile, dir = "/tmp";
+    long long nets = 0;
+    int segs = 12;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i + 1 < argc; ++i) {
+        std::string opt = argv[i];
+        if (opt == "--route") routeFile = argv[++i];
+        else if (opt == "--nets") nets = std::atoll(argv[++i]);
+        else if (opt == "--segs") segs = std::atoi(argv[++i]);
+        else if (opt == "--threads") threads = std::max(1, std::atoi(argv[++i]));
+        else if (opt == "--dir") dir = argv[++i];
+    }
+
+    RoutingResult result;
+    std::string label;
+    if (!routeFile.empty()) {
+        if (!loadRoute(routeFile, result)) {
+            std::cerr << "Error: cannot read " << routeFile << "\n";
+            return 1;
+        }
+        label = routeFile;
+    } else if (nets > 0) {
+        result = synthetic(nets, segs);
+        label = "synthetic " + std::to_string(nets) + " nets x " + std::to_string(segs) + " segments";
+    } else {
+        std::cerr << "Usage: " << argv[0] << " (--route case.route | --nets N [--segs K])"
+                  << " [--threads T] [--dir D]\n";
+        return 1;
+    }
+
+    const std::string ref = dir + "/write_bench.ref", out = dir + "/write_bench.out";
+    const double tr = bestOf3([&] { return writeReference(ref, result); });
+    const double t1 = bestOf3([&] { return writeRouteFile(out, result, 1); });
+    const std::string expected = slurp(ref);
+    bool same = slurp(out) == expected;
+    const double tt = bestOf3([&] { return writeRouteFile(out, result, threads); });
+    same = same && slurp(out) == expected;
+    std::remove(ref.c_str());
+    std::remove(out.c_str());
+    if (tr < 0 || t1 < 0 || tt < 0) {
+        std::cerr << "Error: cannot write to " << dir << "\n";
+        return 1;
+    }
+
+    const double mb = expected.size() / 1e6;
+    std::cout << std::fixed << std::setprecision(1)
+              << label << ": " << mb << " MB\n"
+              << "  ofstream            " << std::setw(8) << tr * 1e3 << " ms  "
+              << std::setw(7) << mb / tr << " MB/s\n"
+              << "  writeRouteFile x1   " << std::setw(8) << t1 * 1e3 << " ms  "
+              << std::setw(7) << mb / t1 << " MB/s\n"
+              << "  writeRouteFile x" << std::left << std::setw(4) << threads << std::right
+              << std::setw(8) << tt * 1e3 << " ms  " << std::setw(7) << mb / tt << " MB/s\n";
+    if (!same) {
+        std::cout << "  output differs from the reference writer\n";
+        return 2;
+    }
+    return 0;
+}
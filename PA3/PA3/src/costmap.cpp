@@ -0,0 +1,184 @@
+// costmap.cpp
+#include "costmap.h"
+#include "graph.h"
+#include "pqueue.h"
+#include <algorithm>
+#include <cassert>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PA3_COST_AVX2 1
+#endif
+
+namespace {
+
+constexpr int TOP_STEP = PRESENT_STEPS - 1;  // overflow + 1 stops growing here
+
+// the fixed model, shifted one step: index 1 is a full gcell, not yet over
+constexpr PresentCosts exponentialTable() {
+    const long long baseCost = 100000;
+    const long long alpha = 1000;
+    PresentCosts cost = {};
+    for (int k = 2; k <= TOP_STEP; ++k) cost[k] = alpha * ((1LL << (k - 1)) - 1) + baseCost;
+    return cost;
+}
+constexpr PresentCosts exponential = exponentialTable();
+
+int presentStep(int demand, int capacity) {
+    return std::min(TOP_STEP, std::max(0, demand + 1 - capacity));
+}
+
+void congestionCostsScalar(const int *demand, const int *capacity, const long long *history,
+                           long long beta, long long *out, int from, int n,
+                           const PresentCosts &present) {
+    for (int i = from; i < n; ++i) {
+        out[i] = present[presentStep(demand[i], capacity[i])];
+        if (history) out[i] += beta * history[i];
+    }
+}
+
+#ifdef PA3_COST_AVX2
+// low 64 bits of a * b per lane; AVX2 only multiplies 32 x 32 -> 64
+__attribute__((target("avx2"))) inline __m256i mul64(__m256i a, __m256i b) {
+    const __m256i lo = _mm256_mul_epu32(a, b);
+    const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                           _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// eight cells per step: step = clamp(demand + 1 - capacity, 0, 21) in one
+// 256-bit lane set, then two 4-wide gathers from the table; returns where
+// the scalar tail starts
+__attribute__((target("avx2"))) int congestionCostsAvx2(
+    const int *demand, const int *capacity, const long long *history,
+    long long beta, long long *out, int n, const PresentCosts &present) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i top = _mm256_set1_epi32(TOP_STEP);
+    const __m256i b = _mm256_set1_epi64x(beta);
+    const long long *table = present.data();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(demand + i));
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(capacity + i));
+        const __m256i o = _mm256_min_epi32(
+            _mm256_max_epi32(_mm256_add_epi32(_mm256_sub_epi32(d, c), one), zero), top);
+        __m256i lo = _mm256_i32gather_epi64(table, _mm256_castsi256_si128(o), 8);
+        __m256i hi = _mm256_i32gather_epi64(table, _mm256_extracti128_si256(o, 1), 8);
+        if (history) {
+            const __m256i h0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(history + i));
+            const __m256i h1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(history + i + 4));
+            lo = _mm256_add_epi64(lo, mul64(h0, b));
+            hi = _mm256_add_epi64(hi, mul64(h1, b));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 4), hi);
+    }
+    return i;
+}
+#endif
+
+} // namespace
+
+// padded: the border rows, and the gap from the end of one row to the start
+// of the next; tiled: the cells past the grid in the last block row and column
+void blockSentinels(const Grid &grid, std::vector<long long> &costs) {
+    if (grid.tiled()) {
+        constexpr int perTile = 2 * Grid::TILE * Grid::TILE;
+        const int tilesPerRow = grid.tilesPerRow();
+        const int tiles = grid.numCells() / perTile;
+        const bool ragged = grid.xSize() % Grid::TILE != 0;
+        for (int t = 0; t < tiles; ++t) {
+            if (t < tiles - tilesPerRow && (!ragged || t % tilesPerRow != tilesPerRow - 1)) continue;
+            for (int idx = t * perTile; idx < (t + 1) * perTile; ++idx)
+                if (!grid.isCell(idx)) costs[idx] = INF;
+        }
+        return;
+    }
+    if (!grid.padded()) return;
+    for (int l = 0; l < grid.numLayers(); ++l) {
+        int from = l * grid.layerStride();
+        for (int i = 0; i < grid.ySize(); ++i) {
+            std::fill(costs.begin() + from, costs.begin() + grid.indexOf(l, 0, i), INF);
+            from = grid.indexOf(l, grid.xSize() - 1, i) + 1;
+        }
+        std::fill(costs.begin() + from, costs.begin() + (l + 1) * grid.layerStride(), INF);
+    }
+}
+
+const PresentCosts &exponentialPresentCosts() {
+    return exponential;
+}
+
+long long maxPresentCost(int numVertices) {
+    const int n = std::max(1, numVertices);
+    return RadixHeap::maxExactKey(n) / 2 / n;
+}
+
+double maxPresentFactor(long long unit, int numVertices) {
+    return static_cast<double>(maxPresentCost(numVertices)) / (static_cast<double>(unit) * TOP_STEP);
+}
+
+PresentCosts negotiatedPresentCosts(double factor, long long unit, int numVertices) {
+    PresentCosts cost = {};
+    for (int k = 1; k <= TOP_STEP; ++k)
+        cost[k] = static_cast<long long>(factor * static_cast<double>(unit) * k);
+    // the longest path at the top step must still be an exact queue key
+    const int n = std::max(1, numVertices);
+    assert(static_cast<double>(cost[TOP_STEP]) * n <= static_cast<double>(RadixHeap::maxExactKey(n)) / 2);
+    (void)n;
+    return cost;
+}
+
+long long congestionCost(int demand, int capacity, const PresentCosts &present) {
+    return present[presentStep(demand, capacity)];
+}
+
+bool congestionCostsHaveSimd() {
+#ifdef PA3_COST_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void congestionCosts(const int *demand, const int *capacity, const long long *history,
+                     long long beta, long long *out, int n, bool simd,
+                     const PresentCosts &present) {
+    int from = 0;
+#ifdef PA3_COST_AVX2
+    if (simd && congestionCostsHaveSimd())
+        from = congestionCostsAvx2(demand, capacity, history, beta, out, n, present);
+#else
+    (void)simd;
+#endif
+    congestionCostsScalar(demand, capacity, history, beta, out, from, n, present);
+}
+
+void CostMap::reset(Grid &grid) {
+    history_.assign(grid.numCells(), 0);
+    refresh(grid);
+}
+
+void CostMap::refresh(Grid &grid) {
+    const int total = grid.numCells();
+    costs_.resize(total);
+    congestionCosts(grid.demandData(), grid.capacityData(), history_.data(), beta_, costs_.data(),
+                    total, true, present_);
+    blockSentinels(grid, costs_);
+    grid.clearDemandChanges();
+}
+
+void CostMap::sync(Grid &grid, std::vector<int> *changed) {
+    for (int idx : grid.demandChanges())
+        costs_[idx] = congestionCost(grid.demandAt(idx), grid.capacityAt(idx), present_)
+                    + beta_ * history_[idx];
+    if (changed)
+        changed->insert(changed->end(), grid.demandChanges().begin(), grid.demandChanges().end());
+    grid.clearDemandChanges();
+}
+
+void CostMap::addHistory(int idx, long long inc) {
+    history_[idx] += inc;
+    costs_[idx] += beta_ * inc;
+}
@@ -0,0 +1,76 @@
+// costmap.h
+#ifndef COSTMAP_H
+#define COSTMAP_H
+
+#include "grid.h"
+#include <array>
+#include <vector>
+
+/// Congestion part of a gcell's routing cost, indexed by how far over
+/// capacity the gcell is with one more net on it:
+/// clamp(demand + 1 - capacity, 0, PRESENT_STEPS - 1).
+constexpr int PRESENT_STEPS = 22;
+using PresentCosts = std::array<long long, PRESENT_STEPS>;
+
+/// The fixed model: a gcell already over capacity by o costs
+/// 100000 + 1000 * (2^o - 1), o clamped to 20; any other gcell costs 0.
+const PresentCosts &exponentialPresentCosts();
+/// Largest present cost a gcell may get in a grid of numVertices gcells: a
+/// path through every gcell at that cost uses at most half of the keys the
+/// radix heap keeps exact, which leaves the other half to wire length and
+/// history.  About 1.2e7 on case4.
+long long maxPresentCost(int numVertices);
+/// Largest factor for negotiatedPresentCosts(): the top step, the only one
+/// that could pass maxPresentCost, stays at or below it, so every overflow
+/// level still costs more than the one below.
+double maxPresentFactor(long long unit, int numVertices);
+/// PathFinder's present-congestion term: factor * unit per unit the gcell
+/// would be over capacity.  factor must not exceed maxPresentFactor().
+PresentCosts negotiatedPresentCosts(double factor, long long unit, int numVertices);
+
+long long congestionCost(int demand, int capacity,
+                         const PresentCosts &present = exponentialPresentCosts());
+
+/// out[i] = congestionCost(demand[i], capacity[i], present) + beta * history[i]
+/// for i < n (history may be null).  With simd the cells go eight at a
+/// time through AVX2 when the CPU has it, otherwise one at a time.
+void congestionCosts(const int *demand, const int *capacity, const long long *history,
+                     long long beta, long long *out, int n, bool simd = true,
+                     const PresentCosts &present = exponentialPresentCosts());
+bool congestionCostsHaveSimd();
+/// Sets costs to INF on every index of a padded or tiled grid that is not a cell.
+void blockSentinels(const Grid &grid, std::vector<long long> &costs);
+
+/// Per-vertex routing cost, congestionCost + beta * history, that astar
+/// reads directly; INF on the sentinels of a padded or tiled grid.  It is
+/// kept in sync incrementally: sync() recomputes only the cells whose demand
+/// changed since the last call (tracked by the Grid demand mutators), and
+/// addHistory() updates a single cell.
+class CostMap {
+public:
+    explicit CostMap(long long beta) : beta_(beta), present_(exponentialPresentCosts()) {}
+
+    /// Full recompute; history starts at zero.
+    void reset(Grid &grid);
+    /// Full recompute, keeping the history.
+    void refresh(Grid &grid);
+    /// Recomputes the cells whose demand changed; appends them to changed.
+    void sync(Grid &grid, std::vector<int> *changed = nullptr);
+
+    /// Congestion costs from now on; the cells already computed keep the
+    /// old ones until the next reset() or refresh().
+    void setPresentCosts(const PresentCosts &present) { present_ = present; }
+
+    void addHistory(int idx, long long inc);
+    long long history(int idx) const { return history_[idx]; }
+
+    const std::vector<long long> &costs() const { return costs_; }
+
+private:
+    long long beta_;
+    PresentCosts present_;
+    std::vector<long long> costs_;
+    std::vector<long long> history_;
+};
+
+#endif // COSTMAP_H
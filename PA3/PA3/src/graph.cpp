@@ -1,39 +1,37 @@
 // graph.cpp
 #include "graph.h"
 #include "grid.h"
+#include "perfScope.h"
 #include <algorithm>
+#include <cstdlib>
 #include <functional>
-#include <queue>
 #include <stdexcept>
 #include <utility>
 
-namespace {
-
-long long manhattanDistance(const Grid &grid, int fromIdx, int toIdx) {
-    Coord3D from = grid.fromIndex(fromIdx);
-    Coord3D to = grid.fromIndex(toIdx);
-
-    long long cost = 0;
-    int minCol = std::min(from.col, to.col);
-    int maxCol = std::max(from.col, to.col);
-    for (int c = minCol; c < maxCol; ++c) {
-        cost += grid.horizontalDist(c);
-    }
-
-    int minRow = std::min(from.row, to.row);
-    int maxRow = std::max(from.row, to.row);
-    for (int r = minRow; r < maxRow; ++r) {
-        cost += grid.verticalDist(r);
-    }
-
+long long manhattanDistance(const Grid &grid, const Coord3D &from, const Coord3D &to) {
+    long long cost = std::llabs(grid.colPosition(from.col) - grid.colPosition(to.col))
+                   + std::llabs(grid.rowPosition(from.row) - grid.rowPosition(to.row));
     if (from.layer != to.layer) {
         cost += grid.wlViaCost();
     }
-
     return cost;
 }
 
-} // namespace
+long long manhattanDistance(const Grid &grid, int fromIdx, int toIdx) {
+    return manhattanDistance(grid, grid.coordOf(fromIdx), grid.coordOf(toIdx));
+}
+
+// Coordinate of v from that of its neighbor u, without a decode.  Every
+// edge is a via or a step along u's preferred direction; a via is the one
+// with delta == viaStep, and in-layer steps move the index the same way as
+// the coordinate in every layout.
+static Coord3D stepCoord(const Grid &grid, const Coord3D &uc, int delta) {
+    Coord3D c = uc;
+    if (delta == grid.viaStep(uc.layer)) c.layer = 1 - c.layer;
+    else if (grid.layerInfo(uc.layer).direction == 'H') c.col += delta > 0 ? 1 : -1;
+    else c.row += delta > 0 ? 1 : -1;
+    return c;
+}
 
 Graph::Graph() = default;
 
@@ -46,10 +44,10 @@ void Graph::resize(int numVertices) {
 }
 
 void Graph::addEdge(int u, int v, long long baseCost) {
-    // TODO: add edge (u, v) between GCell u and v with baseCosts to the graph
     adj_[u].push_back({v, baseCost});
 }
 
+template <typename QueueT>
 std::vector<long long> dijkstra(
     const Graph &g,
     int source,
@@ -60,16 +58,16 @@ std::vector<long long> dijkstra(
     std::vector<long long> dist(n, INF);
     std::vector<int> prev(n, -1);
 
-    using Node = std::pair<long long, int>; // (dist, vertex)
-    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> pq;
+    QueueT pq;
+    pq.reset(n);
 
     dist[source] = 0;
-    pq.push({0, source});
+    pq.push(0, source);
 
     while (!pq.empty()) {
-        auto [d, u] = pq.top();
-        pq.pop();
-        if (d != dist[u]) continue;
+        auto [d, u] = pq.pop();
+        if (d != pq.normalize(dist[u])) continue;
+        d = dist[u];
 
         for (const Edge &e : g.adj(u)) {
             int v = e.to;
@@ -77,7 +75,7 @@ std::vector<long long> dijkstra(
             if (nd < dist[v]) {
                 dist[v] = nd;
                 prev[v] = u;
-                pq.push({nd, v});
+                pq.push(nd, v);
             }
         }
     }
@@ -86,50 +84,158 @@ std::vector<long long> dijkstra(
     return dist;
 }
 
-std::vector<long long> astar(
-    const Graph &g,
+template std::vector<long long> dijkstra<BinaryHeap>(
+    const Graph &, int, std::vector<long long> &, std::vector<int> *);
+template std::vector<long long> dijkstra<RadixHeap>(
+    const Graph &, int, std::vector<long long> &, std::vector<int> *);
+
+void SearchWorkspace::begin(int numVertices) {
+    if (static_cast<int>(stamp_.size()) < numVertices) {
+        gScore_.resize(numVertices);
+        bestF_.resize(numVertices);
+        prev_.resize(numVertices);
+        stamp_.resize(numVertices, 0);
+    }
+    if (++epoch_ == 0) {
+        // stamps wrapped around; old entries could look current again
+        std::fill(stamp_.begin(), stamp_.end(), 0);
+        epoch_ = 1;
+    }
+    touched_.clear();
+}
+
+template <typename GraphT, typename QueueT>
+long long astar(
+    const GraphT &g,
     const Grid &grid,
     int source,
     int target,
-    std::vector<long long> &vertex_cost,
-    std::vector<int> *outPrev
+    const std::vector<long long> &vertex_cost,
+    SearchWorkspace &ws
 ) {
-    const int n = g.numVertices();
-    std::vector<long long> gScore(n, INF);
-    std::vector<int> prev(n, -1);
-    std::vector<long long> bestF(n, INF);
-
-    using Node = std::pair<long long, int>; // (fScore, vertex)
-    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> pq;
-
-    auto heuristic = [&](int idx) {
-        return manhattanDistance(grid, idx, target);
+    perf::Scope scope("astar");
+    ws.begin(g.numVertices());
+    QueueT &open = ws.queue<QueueT>();
+    open.reset(g.numVertices());
+
+    const Coord3D targetCoord = grid.coordOf(target);
+    auto heuristic = [&](const Coord3D &c) {
+        return manhattanDistance(grid, c, targetCoord);
     };
 
-    gScore[source] = 0;
-    bestF[source] = heuristic(source);
-    pq.push({bestF[source], source});
+    ws.set(source, 0, heuristic(grid.coordOf(source)), -1);
+    open.push(ws.f(source), source);
 
-    while (!pq.empty()) {
-        auto [fScore, u] = pq.top();
-        pq.pop();
-        if (fScore != bestF[u]) continue;
+    while (!open.empty()) {
+        auto [fScore, u] = open.pop();
+        if (fScore != open.normalize(ws.f(u))) continue;
         if (u == target) break;
-        if (gScore[u] == INF) continue;
-
-        for (const Edge &e : g.adj(u)) {
-            int v = e.to;
-            long long tentativeG = gScore[u] + e.baseCost + vertex_cost[v];
-            if (tentativeG < gScore[v]) {
-                gScore[v] = tentativeG;
-                prev[v] = u;
-                long long newF = tentativeG + heuristic(v);
-                bestF[v] = newF;
-                pq.push({newF, v});
+        const long long gu = ws.g(u);
+        if (gu == INF) continue;
+
+        const Coord3D uc = grid.coordOf(u);  // the only decode per pop
+        g.forEachNeighbor(u, uc, [&](int v, long long baseCost) {
+            long long tentativeG = gu + baseCost + vertex_cost[v];
+            if (tentativeG < ws.g(v)) {
+                long long newF = tentativeG + heuristic(stepCoord(grid, uc, v - u));
+                ws.set(v, tentativeG, newF, u);
+                open.push(newF, v);
             }
-        }
+        });
     }
 
-    if (outPrev) *outPrev = std::move(prev);
-    return gScore;
+    return ws.g(target);
 }
+
+// Both searches use the average potential p(v) = (h_t(v) - h_s(v)) / 2 (the
+// reverse one uses -p), which is consistent for both directions, so each
+// side is a plain Dijkstra on the same reduced costs.  Keys are kept doubled,
+// 2g + h_t - h_s forward and 2g + h_s - h_t backward, to stay integral, and
+// shifted by the grid's extent so they are never negative.  The search may
+// stop once the two smallest keys sum to at least 2 * mu (plus both
+// shifts), mu being the best complete path seen.  In bwd, g(v) is the cost
+// from v to the target not counting vertex_cost[v], so a path through v
+// costs fwd.g(v) + bwd.g(v).
+template <typename GraphT, typename QueueT>
+long long bidirectionalAstar(
+    const GraphT &g,
+    const Grid &grid,
+    int source,
+    int target,
+    const std::vector<long long> &vertex_cost,
+    SearchWorkspace &fwd,
+    SearchWorkspace &bwd,
+    int &meet
+) {
+    perf::Scope scope("astar-bidir");
+    fwd.begin(g.numVertices());
+    bwd.begin(g.numVertices());
+    QueueT &openF = fwd.queue<QueueT>();
+    QueueT &openR = bwd.queue<QueueT>();
+    openF.reset(g.numVertices());
+    openR.reset(g.numVertices());
+    const Coord3D sourceCoord = grid.coordOf(source);
+    const Coord3D targetCoord = grid.coordOf(target);
+    // doubled forward potential 2p(v) = h_t(v) - h_s(v), |2p| <= shift
+    const long long shift = grid.colPosition(grid.xSize() - 1)
+                          + grid.rowPosition(grid.ySize() - 1) + grid.wlViaCost();
+    auto potential2 = [&](const Coord3D &c) {
+        return manhattanDistance(grid, c, targetCoord) - manhattanDistance(grid, c, sourceCoord);
+    };
+
+    long long mu = INF;
+    meet = -1;
+    if (source == target) {
+        fwd.set(source, 0, 0, -1);
+        meet = source;
+        return 0;
+    }
+    const long long p2s = potential2(sourceCoord), p2t = potential2(targetCoord);
+    fwd.set(source, 0, shift + p2s, -1);
+    openF.push(shift + p2s, source);
+    bwd.set(target, 0, shift - p2t, -1);
+    openR.push(shift - p2t, target);
+
+    auto settle = [&](SearchWorkspace &self, QueueT &open, SearchWorkspace &other, bool forward) {
+        auto [key, u] = open.pop();
+        if (key != open.normalize(self.f(u))) return;
+        const long long gu = self.g(u);
+        const Coord3D uc = grid.coordOf(u);
+        g.forEachNeighbor(u, uc, [&](int v, long long baseCost) {
+            // forward: edge u->v costs base + cost[v]; backward: the
+            // original edge v->u costs base + cost[u], so a blocked v
+            // (a sentinel) has to be turned away explicitly
+            const long long gv = gu + baseCost + vertex_cost[forward ? v : u];
+            if (gv >= self.g(v) || (!forward && vertex_cost[v] >= INF)) return;
+            const long long p2 = potential2(stepCoord(grid, uc, v - u));
+            const long long k = 2 * gv + shift + (forward ? p2 : -p2);
+            self.set(v, gv, k, u);
+            open.push(k, v);
+            const long long gOther = other.g(v);
+            if (gOther < INF && gv + gOther < mu) {
+                mu = gv + gOther;
+                meet = v;
+            }
+        });
+    };
+
+    while (!openF.empty() && !openR.empty()) {
+        if (mu < INF && openF.topKey() + openR.topKey() >= 2 * (mu + shift)) break;
+        if (openF.size() <= openR.size()) settle(fwd, openF, bwd, true);
+        else settle(bwd, openR, fwd, false);
+    }
+    return mu;
+}
+
+#define PA3_INSTANTIATE_SEARCH(GraphT, QueueT)                                   \
+    template long long astar<GraphT, QueueT>(                                   \
+        const GraphT &, const Grid &, int, int, const std::vector<long long> &, \
+        SearchWorkspace &);                                                     \
+    template long long bidirectionalAstar<GraphT, QueueT>(                      \
+        const GraphT &, const Grid &, int, int, const std::vector<long long> &, \
+        SearchWorkspace &, SearchWorkspace &, int &);
+
+PA3_INSTANTIATE_SEARCH(Graph, BinaryHeap)
+PA3_INSTANTIATE_SEARCH(Graph, RadixHeap)
+PA3_INSTANTIATE_SEARCH(GridGraph, BinaryHeap)
+PA3_INSTANTIATE_SEARCH(GridGraph, RadixHeap)
@@ -2,11 +2,15 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include "grid.h"
+#include "pqueue.h"
 #include <vector>
 #include <limits>
 #include <climits>
+#include <tuple>
+#include <utility>
 
-class Grid;
+const long long INF = LLONG_MAX >> 4;
 
 // Simple directed edge for adjacency list
 struct Edge {
@@ -27,12 +31,124 @@ public:
 
     const std::vector<Edge>& adj(int u) const { return adj_[u]; }
 
+    /// Calls f(v, baseCost) for every edge (u, v); uc is unused here.
+    template <typename F>
+    void forEachNeighbor(int u, const Coord3D & /*uc*/, F &&f) const {
+        for (const Edge &e : adj_[u]) f(e.to, e.baseCost);
+    }
+
 private:
     std::vector<std::vector<Edge>> adj_;
 };
 
+/// Inclusive column/row range a GridGraph search may use, on both layers.
+struct SearchWindow {
+    int colLo = 0, colHi = -1;
+    int rowLo = 0, rowHi = -1;
+
+    static SearchWindow whole(const Grid &grid) {
+        return SearchWindow{0, grid.xSize() - 1, 0, grid.ySize() - 1};
+    }
+    bool coversGrid(const Grid &grid) const {
+        return colLo <= 0 && rowLo <= 0 && colHi >= grid.xSize() - 1 && rowHi >= grid.ySize() - 1;
+    }
+    int width() const { return colHi - colLo + 1; }
+    int height() const { return rowHi - rowLo + 1; }
+};
+
+/// Zero-storage view of the same graph buildGraphFromGrid() materializes:
+/// a gcell's neighbors are derived on the fly from its layer's preferred
+/// direction, W_j / H_i and the via cost.  An optional window hides every
+/// gcell outside it.  On a padded grid (Grid::setLayout) without a window
+/// no bounds are tested: steps off the grid land on sentinel cells, which
+/// the caller's costs must block (vertex cost >= INF).
+class GridGraph {
+public:
+    explicit GridGraph(const Grid &grid)
+        : grid_(&grid), window_(SearchWindow::whole(grid)), unbounded_(grid.padded()) {}
+    GridGraph(const Grid &grid, const SearchWindow &window)
+        : grid_(&grid), window_(window), unbounded_(grid.padded() && window.coversGrid(grid)) {}
+
+    int numVertices() const { return grid_->numCells(); }
+
+    /// Calls f(v, baseCost) for every neighbor v of u, whose coordinate is uc.
+    template <typename F>
+    void forEachNeighbor(int u, const Coord3D &uc, F &&f) const {
+        const Grid &g = *grid_;
+        const int l = uc.layer, j = uc.col, i = uc.row;
+        if (unbounded_) {
+            if (g.layerInfo(l).direction == 'H') {
+                f(u - 1, g.horizontalDistAt(j - 1));
+                f(u + 1, g.horizontalDistAt(j));
+            } else {
+                f(u - g.rowStride(), g.verticalDistAt(i - 1));
+                f(u + g.rowStride(), g.verticalDistAt(i));
+            }
+        } else if (g.tiled()) {
+            if (g.layerInfo(l).direction == 'H') {
+                if (j > window_.colLo) f(g.indexOf(l, j - 1, i), g.horizontalDistAt(j - 1));
+                if (j < window_.colHi) f(g.indexOf(l, j + 1, i), g.horizontalDistAt(j));
+            } else {
+                if (i > window_.rowLo) f(g.indexOf(l, j, i - 1), g.verticalDistAt(i - 1));
+                if (i < window_.rowHi) f(g.indexOf(l, j, i + 1), g.verticalDistAt(i));
+            }
+        } else if (g.layerInfo(l).direction == 'H') {
+            if (j > window_.colLo) f(u - 1, g.horizontalDistAt(j - 1));
+            if (j < window_.colHi) f(u + 1, g.horizontalDistAt(j));
+        } else {
+            if (i > window_.rowLo) f(u - g.rowStride(), g.verticalDistAt(i - 1));
+            if (i < window_.rowHi) f(u + g.rowStride(), g.verticalDistAt(i));
+        }
+        f(u + g.viaStep(l), g.wlViaCost());
+    }
+
+private:
+    const Grid *grid_;
+    SearchWindow window_;
+    bool unbounded_;
+};
+
+/// Per-vertex A* state kept across searches.  An entry is valid only while
+/// its stamp equals the current epoch, so begin() is O(1) instead of an O(V)
+/// refill and a search costs what it explores.  touched() lists the vertices
+/// the current search has written.
+class SearchWorkspace {
+public:
+    void begin(int numVertices);
+
+    long long g(int v) const { return stamp_[v] == epoch_ ? gScore_[v] : INF; }
+    long long f(int v) const { return stamp_[v] == epoch_ ? bestF_[v] : INF; }
+    int prev(int v) const { return stamp_[v] == epoch_ ? prev_[v] : -1; }
+
+    void set(int v, long long g, long long f, int prev) {
+        if (stamp_[v] != epoch_) {
+            stamp_[v] = epoch_;
+            touched_.push_back(v);
+        }
+        gScore_[v] = g;
+        bestF_[v] = f;
+        prev_[v] = prev;
+    }
+
+    const std::vector<int> &touched() const { return touched_; }
+    /// Open list of the given queue type (see pqueue.h), kept for reuse.
+    template <typename QueueT>
+    QueueT &queue() { return std::get<QueueT>(queues_); }
+
+private:
+    std::vector<long long> gScore_;
+    std::vector<long long> bestF_;
+    std::vector<int> prev_;
+    std::vector<unsigned> stamp_;
+    unsigned epoch_ = 0;
+    std::vector<int> touched_;
+    std::tuple<BinaryHeap, RadixHeap> queues_;
+};
+
 /// A minimal Dijkstra interface that students can call or modify.
 /// They can also write their own version if they prefer.
+/// QueueT is BinaryHeap or RadixHeap (pqueue.h).
+template <typename QueueT = BinaryHeap>
 std::vector<long long> dijkstra(
     const Graph &g,
     int source,
@@ -40,15 +156,40 @@ std::vector<long long> dijkstra(
     std::vector<int> *outPrev = nullptr   // optional predecessor tree
 );
 
-std::vector<long long> astar(
-    const Graph &g,
+/// Lower bound on the wirelength cost between two gcells.
+long long manhattanDistance(const Grid &grid, int fromIdx, int toIdx);
+long long manhattanDistance(const Grid &grid, const Coord3D &from, const Coord3D &to);
+
+/// A* over either graph view (Graph or GridGraph).  Returns the cost of the
+/// best source-target path (INF if none); ws.prev() holds the path.
+/// QueueT is the open list, BinaryHeap or RadixHeap (pqueue.h).
+template <typename GraphT, typename QueueT = BinaryHeap>
+long long astar(
+    const GraphT &g,
     const Grid &grid,
     int source,
     int target,
-    std::vector<long long>&vertex_cost,
-    std::vector<int> *outPrev = nullptr
+    const std::vector<long long> &vertex_cost,
+    SearchWorkspace &ws
 );
 
-const long long INF = LLONG_MAX >> 4;
+/// Bidirectional A* with the same cost model as astar(): a path costs the
+/// base costs of its edges plus vertex_cost of every vertex after the
+/// source.  fwd searches from source, bwd from target over the reversed
+/// edges (the grid graphs are symmetric, so that is the same neighbor set).
+/// Returns the optimal cost (INF if none) and the vertex both halves met at;
+/// fwd.prev() leads from meet back to source, bwd.prev() from meet on to
+/// target.
+template <typename GraphT, typename QueueT = BinaryHeap>
+long long bidirectionalAstar(
+    const GraphT &g,
+    const Grid &grid,
+    int source,
+    int target,
+    const std::vector<long long> &vertex_cost,
+    SearchWorkspace &fwd,
+    SearchWorkspace &bwd,
+    int &meet
+);
 
 #endif // GRAPH_H
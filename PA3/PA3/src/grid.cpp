@@ -1,6 +1,7 @@
 // grid.cpp
 #include "grid.h"
 #include <algorithm>
+#include <cstdlib>
 #include <stdexcept>
 
 Grid::Grid() = default;
@@ -8,29 +9,85 @@ Grid::Grid() = default;
 void Grid::resize(int xSize, int ySize) {
     xSize_ = xSize;
     ySize_ = ySize;
-    const int total = numLayers() * xSize_ * ySize_;
+    relayout(layout_);
+    W_.assign(xSize_ + 1, 0);
+    H_.assign(ySize_ + 1, 0);
+    colPos_.assign(xSize_, 0);
+    rowPos_.assign(ySize_, 0);
+}
+
+// strides for the layout, then every per-cell array sized and emptied
+void Grid::relayout(GridLayout layout) {
+    layout_ = layout;
+    if (layout == GridLayout::Tiled) {
+        tilesPerRow_ = (xSize_ + TILE - 1) >> TILE_SHIFT;
+        const int tileRows = (ySize_ + TILE - 1) >> TILE_SHIFT;
+        numCells_ = tilesPerRow_ * tileRows * 2 * TILE * TILE;
+        pad_ = rowStride_ = layerStride_ = origin_ = 0;
+        rowShift_ = -1;
+    } else {
+        const bool padded = layout == GridLayout::Padded;
+        pad_ = padded ? 1 : 0;
+        rowStride_ = xSize_ + 2 * pad_;
+        if (padded) {
+            int pow2 = 1;
+            while (pow2 < rowStride_) pow2 <<= 1;
+            rowStride_ = pow2;
+        }
+        rowShift_ = rowStride_ > 0 && (rowStride_ & (rowStride_ - 1)) == 0 ? __builtin_ctz(rowStride_) : -1;
+        layerStride_ = rowStride_ * (ySize_ + 2 * pad_);
+        origin_ = pad_ * rowStride_ + pad_;
+        numCells_ = 2 * layerStride_;
+        tilesPerRow_ = 0;
+    }
+
+    const int total = numCells();
     capacity_.assign(total, 0);
     demand_.assign(total, 0);
-    W_.assign(xSize_ > 0 ? xSize_ - 1 : 0, 0);
-    H_.assign(ySize_ > 0 ? ySize_ - 1 : 0, 0);
+    demandChanges_.clear();
+    demandChanged_.assign(total, 0);
+    totalOverflow_ = 0;
+    overfull_.clear();
+    overfullPos_.assign(total, -1);
+    wirelength_ = 0;
+    vias_ = 0;
+    netsAt_.assign(total, std::vector<int>());
+}
+
+void Grid::setLayout(GridLayout layout) {
+    std::vector<int> caps;
+    caps.reserve(static_cast<size_t>(numLayers()) * xSize_ * ySize_);
+    for (int l = 0; l < numLayers(); ++l)
+        for (int i = 0; i < ySize_; ++i)
+            for (int j = 0; j < xSize_; ++j) caps.push_back(capacity_[indexOf(l, j, i)]);
+    relayout(layout);
+    setCapacities(caps.data());
+}
+
+bool Grid::isCell(int idx) const {
+    if (idx < 0 || idx >= numCells()) return false;
+    const Coord3D c = coordOf(idx);
+    return c.col >= 0 && c.col < xSize_ && c.row >= 0 && c.row < ySize_;
+}
+
+static void prefixSums(const std::vector<int> &dist, std::vector<long long> &pos) {
+    long long sum = 0;
+    for (size_t k = 0; k < pos.size(); ++k) {
+        pos[k] = sum;
+        if (k < dist.size()) sum += dist[k];
+    }
 }
 
 int Grid::gcellIndex(int l, int j, int i) const {
     if (l < 0 || l >= numLayers() || j < 0 || j >= xSize_ || i < 0 || i >= ySize_)
         throw std::out_of_range("Invalid gcell coordinate");
-    return l * (xSize_ * ySize_) + i * xSize_ + j;
+    return indexOf(l, j, i);
 }
 
 Coord3D Grid::fromIndex(int idx) const {
-    if (idx < 0 || idx >= static_cast<int>(capacity_.size()))
+    if (!isCell(idx))
         throw std::out_of_range("Invalid gcell index");
-    int perLayer = xSize_ * ySize_;
-    Coord3D c;
-    c.layer = idx / perLayer;
-    int rem = idx % perLayer;
-    c.row = rem / xSize_;
-    c.col = rem % xSize_;
-    return c;
+    return coordOf(idx);
 }
 
 int Grid::capacity(int l, int j, int i) const {
@@ -44,7 +101,18 @@ int Grid::capacityByIndex(int idx) const {
 }
 
 void Grid::setCapacity(int l, int j, int i, int cap) {
-    capacity_[gcellIndex(l, j, i)] = cap;
+    int idx = gcellIndex(l, j, i);
+    totalOverflow_ -= std::max(0, demand_[idx] - capacity_[idx]);
+    capacity_[idx] = cap;
+    totalOverflow_ += std::max(0, demand_[idx] - capacity_[idx]);
+    demandChanged(idx);  // keeps overfull_ and the change list in step
+}
+
+void Grid::setCapacities(const int *caps) {
+    for (int l = 0; l < numLayers(); ++l)
+        for (int i = 0; i < ySize_; ++i)
+            for (int j = 0; j < xSize_; ++j) capacity_[indexOf(l, j, i)] = *caps++;
+    resetDemand();
 }
 
 int Grid::demand(int l, int j, int i) const {
@@ -53,13 +121,118 @@ int Grid::demand(int l, int j, int i) const {
 
 void Grid::resetDemand() {
     std::fill(demand_.begin(), demand_.end(), 0);
+    clearDemandChanges();
+    for (std::vector<int> &ids : netsAt_) ids.clear();
+    totalOverflow_ = 0;
+    for (int idx : overfull_) overfullPos_[idx] = -1;
+    overfull_.clear();
+    for (int idx = 0; idx < static_cast<int>(capacity_.size()); ++idx) {
+        // negative capacity overflows with no demand at all
+        if (capacity_[idx] < 0) {
+            totalOverflow_ -= capacity_[idx];
+            demandChanged(idx);
+        }
+    }
+    wirelength_ = 0;
+    vias_ = 0;
+}
+
+// bookkeeping after demand_[idx] changed: the change list and membership
+// in overfull_ (totalOverflow_ is updated by the caller)
+void Grid::demandChanged(int idx) {
+    if (!demandChanged_[idx]) {
+        demandChanged_[idx] = 1;
+        demandChanges_.push_back(idx);
+    }
+    const bool was = overfullPos_[idx] >= 0;
+    const bool is = demand_[idx] > capacity_[idx];
+    if (is && !was) {
+        overfullPos_[idx] = static_cast<int>(overfull_.size());
+        overfull_.push_back(idx);
+    } else if (!is && was) {
+        const int pos = overfullPos_[idx];
+        overfull_[pos] = overfull_.back();
+        overfullPos_[overfull_[pos]] = pos;
+        overfull_.pop_back();
+        overfullPos_[idx] = -1;
+    }
 }
 
-void Grid::addDemandForNetGCell(int /*netId*/, int l, int j, int i) {
-    ++demand_[gcellIndex(l, j, i)];
+void Grid::addDemandForNetGCell(int netId, int l, int j, int i) {
+    addDemandAt(netId, gcellIndex(l, j, i));
 }
-void Grid::removeDemandForNetGCell(int /*netId*/, int l, int j, int i) {
-    --demand_[gcellIndex(l, j, i)];
+void Grid::removeDemandForNetGCell(int netId, int l, int j, int i) {
+    removeDemandAt(netId, gcellIndex(l, j, i));
+}
+
+void Grid::addDemandAt(int netId, int idx) {
+    if (++demand_[idx] > capacity_[idx]) ++totalOverflow_;
+    netsAt_[idx].push_back(netId);
+    demandChanged(idx);
+}
+void Grid::removeDemandAt(int netId, int idx) {
+    if (demand_[idx]-- > capacity_[idx]) --totalOverflow_;
+    std::vector<int> &ids = netsAt_[idx];
+    auto it = std::find(ids.begin(), ids.end(), netId);
+    if (it != ids.end()) {
+        *it = ids.back();
+        ids.pop_back();
+    }
+    demandChanged(idx);
+}
+
+long long Grid::pathLength(const std::vector<Coord3D> &path, long long &vias) const {
+    long long length = 0;
+    vias = 0;
+    for (size_t k = 1; k < path.size(); ++k) {
+        const Coord3D &a = path[k - 1], &b = path[k];
+        if (a.layer != b.layer) ++vias;
+        length += std::llabs(colPosition(a.col) - colPosition(b.col));
+        length += std::llabs(rowPosition(a.row) - rowPosition(b.row));
+    }
+    return length;
+}
+
+// calls f on every gcell of path, expanding each straight run
+template <class F>
+static void forEachGCell(const std::vector<Coord3D> &path, F f) {
+    if (path.empty()) return;
+    f(path[0]);
+    for (size_t k = 1; k < path.size(); ++k) {
+        Coord3D c = path[k - 1];
+        const Coord3D &to = path[k];
+        if (c.layer != to.layer) {
+            c.layer = to.layer;
+            f(c);
+        }
+        while (c.col != to.col) {
+            c.col += c.col < to.col ? 1 : -1;
+            f(c);
+        }
+        while (c.row != to.row) {
+            c.row += c.row < to.row ? 1 : -1;
+            f(c);
+        }
+    }
+}
+
+void Grid::addPathDemand(int netId, const std::vector<Coord3D> &path) {
+    forEachGCell(path, [&](const Coord3D &c) { addDemandAt(netId, indexOf(c.layer, c.col, c.row)); });
+    long long v = 0;
+    wirelength_ += pathLength(path, v);
+    vias_ += v;
+}
+
+void Grid::removePathDemand(int netId, const std::vector<Coord3D> &path) {
+    forEachGCell(path, [&](const Coord3D &c) { removeDemandAt(netId, indexOf(c.layer, c.col, c.row)); });
+    long long v = 0;
+    wirelength_ -= pathLength(path, v);
+    vias_ -= v;
+}
+
+void Grid::clearDemandChanges() {
+    for (int idx : demandChanges_) demandChanged_[idx] = 0;
+    demandChanges_.clear();
 }
 
 int Grid::demandByIndex(int idx) const {
@@ -69,27 +242,31 @@ int Grid::demandByIndex(int idx) const {
 }
 
 int Grid::horizontalDist(int j) const {
-    if (j < 0 || j >= static_cast<int>(W_.size()))
+    if (j < 0 || j >= xSize_ - 1)
         throw std::out_of_range("Invalid horizontal distance index");
-    return W_[j];
+    return W_[j + 1];
 }
 
 int Grid::verticalDist(int i) const {
-    if (i < 0 || i >= static_cast<int>(H_.size()))
+    if (i < 0 || i >= ySize_ - 1)
         throw std::out_of_range("Invalid vertical distance index");
-    return H_[i];
+    return H_[i + 1];
 }
 
 void Grid::setHorizontalDistances(const std::vector<int> &distances) {
     if (static_cast<int>(distances.size()) != (xSize_ > 0 ? xSize_ - 1 : 0))
         throw std::runtime_error("Horizontal distance vector size mismatch");
-    W_ = distances;
+    W_.assign(xSize_ + 1, 0);
+    std::copy(distances.begin(), distances.end(), W_.begin() + 1);
+    prefixSums(distances, colPos_);
 }
 
 void Grid::setVerticalDistances(const std::vector<int> &distances) {
     if (static_cast<int>(distances.size()) != (ySize_ > 0 ? ySize_ - 1 : 0))
         throw std::runtime_error("Vertical distance vector size mismatch");
-    H_ = distances;
+    H_.assign(ySize_ + 1, 0);
+    std::copy(distances.begin(), distances.end(), H_.begin() + 1);
+    prefixSums(distances, rowPos_);
 }
 
 void Grid::setLayerInfo(int l, const LayerInfo &info) {
@@ -3,6 +3,7 @@
 #define GRID_H
 
 #include "types.h"
+#include <cassert>
 #include <vector>
 #include <string>
 
@@ -11,6 +12,8 @@ struct LayerInfo {
     char direction;        // 'H' or 'V'
 };
 
+enum class GridLayout { Dense, Padded, Tiled };
+
 class Grid {
 public:
     Grid();
@@ -19,14 +22,92 @@ public:
     int numLayers() const { return 2; }
     int xSize() const { return xSize_; }
     int ySize() const { return ySize_; }
+    bool contains(const Coord3D &c) const {
+        return c.layer >= 0 && c.layer < 2 && c.col >= 0 && c.col < xSize_ && c.row >= 0 && c.row < ySize_;
+    }
 
     // index mapping between (l, j, i) and a flat GCell index
     int gcellIndex(int l, int j, int i) const;
     Coord3D fromIndex(int idx) const;
 
+    // Layout of the index space.  Dense (the default): l * X*Y + i * X + j.
+    // Padded: every layer gets a border of sentinel cells and rows are a
+    // power of two apart, so the four in-layer neighbors of any real cell
+    // are valid indices and decoding is a compare, a shift and a mask.
+    // Tiled: the grid is cut into TILE x TILE blocks stored one after the
+    // other, row by row; inside a block cells go row by row and the two
+    // layers of a cell are adjacent (l is the low bit), so a via is a step
+    // of 1 and a search front stays within a few cache lines.  The last
+    // block row and column are filled up with sentinels.
+    // Sentinels have no capacity and never carry demand; isCell() is false
+    // for them, and arrays indexed by gcell need numCells() entries.
+    // setLayout() keeps the capacities and clears the demand.
+    static constexpr int TILE_SHIFT = 3;
+    static constexpr int TILE = 1 << TILE_SHIFT;
+    void setLayout(GridLayout layout);
+    GridLayout layout() const { return layout_; }
+    bool padded() const { return layout_ == GridLayout::Padded; }
+    bool tiled() const { return layout_ == GridLayout::Tiled; }
+    int numCells() const { return numCells_; }
+    int rowStride() const { return rowStride_; }      // index step of i + 1; not tiled
+    int layerStride() const { return layerStride_; }  // index step of l + 1; not tiled
+    int viaStep(int l) const {                        // index step from layer l to the other
+        if (layout_ == GridLayout::Tiled) return l ? -1 : 1;
+        return l ? -layerStride_ : layerStride_;
+    }
+    int tilesPerRow() const { return tilesPerRow_; }  // tiled only
+    bool isCell(int idx) const;
+
+    // Unchecked versions of the accessors above and below, for the search
+    // and cost loops; out-of-range arguments only trip an assert in DEBUG=1
+    // builds.
+    int indexOf(int l, int j, int i) const {
+        assert(l >= 0 && l < 2 && j >= 0 && j < xSize_ && i >= 0 && i < ySize_);
+        if (layout_ == GridLayout::Tiled) {
+            constexpr int mask = TILE - 1;
+            const int tile = (i >> TILE_SHIFT) * tilesPerRow_ + (j >> TILE_SHIFT);
+            return tile << (2 * TILE_SHIFT + 1) | (i & mask) << (TILE_SHIFT + 1) | (j & mask) << 1 | l;
+        }
+        return l * layerStride_ + i * rowStride_ + j + origin_;
+    }
+    Coord3D coordOf(int idx) const {
+        assert(idx >= 0 && idx < numCells());
+        Coord3D c;
+        if (layout_ == GridLayout::Tiled) {
+            constexpr int mask = TILE - 1;
+            const int tile = idx >> (2 * TILE_SHIFT + 1);
+            const int tileRow = tile / tilesPerRow_;
+            c.layer = idx & 1;
+            c.row = (tileRow << TILE_SHIFT) | (idx >> (TILE_SHIFT + 1) & mask);
+            c.col = ((tile - tileRow * tilesPerRow_) << TILE_SHIFT) | (idx >> 1 & mask);
+            return c;
+        }
+        c.layer = idx >= layerStride_;
+        const int rem = idx - (c.layer ? layerStride_ : 0);
+        if (rowShift_ >= 0) {
+            c.row = (rem >> rowShift_) - pad_;
+            c.col = (rem & (rowStride_ - 1)) - pad_;
+        } else {
+            c.row = rem / rowStride_;
+            c.col = rem % rowStride_;
+        }
+        return c;
+    }
+    int capacityAt(int idx) const { assert(idx >= 0 && idx < numCells()); return capacity_[idx]; }
+    int demandAt(int idx) const { assert(idx >= 0 && idx < numCells()); return demand_[idx]; }
+    // numCells() entries each, for whole-grid kernels
+    const int *capacityData() const { return capacity_.data(); }
+    const int *demandData() const { return demand_.data(); }
+    // W_j / H_i, and 0 for j = -1, X - 1 (i = -1, Y - 1): the steps onto sentinels
+    int horizontalDistAt(int j) const { assert(j >= -1 && j < xSize_); return W_[j + 1]; }
+    int verticalDistAt(int i) const { assert(i >= -1 && i < ySize_); return H_[i + 1]; }
+
     // capacity & demand on GCells
     int capacity(int l, int j, int i) const;
     void setCapacity(int l, int j, int i, int cap);
+    // all 2 * xSize * ySize capacities, layer by layer and row by row;
+    // clears the demand
+    void setCapacities(const int *caps);
 
     int demand(int l, int j, int i) const;
     void resetDemand();
@@ -35,6 +116,27 @@ public:
     int demandByIndex(int idx) const;
     int capacityByIndex(int idx) const;
 
+    // cells whose demand changed since the last clearDemandChanges()
+    const std::vector<int> &demandChanges() const { return demandChanges_; }
+    void clearDemandChanges();
+
+    // demand of a whole path: consecutive points differ in one coordinate
+    // (a straight run or a via) and every gcell in between is covered, so
+    // both step-by-step paths and their corners work.  Also keeps the wire
+    // length / via totals below.
+    void addPathDemand(int netId, const std::vector<Coord3D> &path);
+    void removePathDemand(int netId, const std::vector<Coord3D> &path);
+
+    // running totals, updated by the demand mutators
+    long long totalOverflow() const { return totalOverflow_; }   // sum of max(0, demand - capacity)
+    const std::vector<int> &overfullCells() const { return overfull_; }  // unordered
+    bool isOverfull(int idx) const { return overfullPos_[idx] >= 0; }    // unchecked
+    long long wirelength() const { return wirelength_; }  // of the paths added, sum of W / H
+    long long vias() const { return vias_; }
+
+    // nets whose demand is on a cell, once per unit of demand; unordered
+    const std::vector<int> &netsAt(int idx) const { return netsAt_[idx]; }  // unchecked
+
     // distances / via cost
     int wlViaCost() const { return wlViaCost_; }
     void setViaCost(int cost) { wlViaCost_ = cost; }
@@ -43,6 +145,11 @@ public:
     void setHorizontalDistances(const std::vector<int> &distances);
     void setVerticalDistances(const std::vector<int> &distances);
 
+    // prefix sums of W / H: the wire length between columns a and b is
+    // |colPosition(a) - colPosition(b)| (same for rows); unchecked
+    long long colPosition(int j) const { return colPos_[j]; }
+    long long rowPosition(int i) const { return rowPos_[i]; }
+
     const LayerInfo& layerInfo(int l) const { return layers_[l]; }
     void setLayerInfo(int l, const LayerInfo &info);
 
@@ -52,12 +159,40 @@ private:
     int xSize_ = 0;
     int ySize_ = 0;
 
-    // size: [2 * xSize * ySize]
+    // size: numCells()
     std::vector<int> capacity_;
     std::vector<int> demand_;
 
-    std::vector<int> W_;  // size xSize-1
-    std::vector<int> H_;  // size ySize-1
+    std::vector<int> demandChanges_;
+    std::vector<unsigned char> demandChanged_;  // membership in demandChanges_
+
+    long long totalOverflow_ = 0;
+    std::vector<int> overfull_;     // cells with demand > capacity
+    std::vector<int> overfullPos_;  // position in overfull_, -1 if not there
+    long long wirelength_ = 0;
+    long long vias_ = 0;
+    std::vector<std::vector<int>> netsAt_;
+
+    void demandChanged(int idx);
+    void addDemandAt(int netId, int idx);
+    void removeDemandAt(int netId, int idx);
+    long long pathLength(const std::vector<Coord3D> &path, long long &vias) const;
+
+    // index layout, see setLayout()
+    GridLayout layout_ = GridLayout::Dense;
+    int numCells_ = 0;
+    int tilesPerRow_ = 0;
+    int pad_ = 0;          // 1 when padded: cell (l, 0, 0) sits at row 1, column 1
+    int rowStride_ = 0;
+    int rowShift_ = -1;    // log2(rowStride_) if it is a power of two, else -1
+    int layerStride_ = 0;
+    int origin_ = 0;       // indexOf(0, 0, 0)
+    void relayout(GridLayout layout);
+
+    std::vector<int> W_;  // size xSize+1: W_[j + 1] = W_j, zero on both ends
+    std::vector<int> H_;  // size ySize+1: H_[i + 1] = H_i, zero on both ends
+    std::vector<long long> colPos_;  // size xSize, colPos_[0] = 0
+    std::vector<long long> rowPos_;  // size ySize, rowPos_[0] = 0
 
     int wlViaCost_ = 0;
     LayerInfo layers_[2];
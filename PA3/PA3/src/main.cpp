@@ -1,37 +1,194 @@
 // main.cpp
 #include "parser.h"
+#include "perfScope.h"
 #include "router.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <iostream>
+#include <string>
+
+namespace {
+
+volatile std::sig_atomic_t caughtSignal = 0;
+
+// First SIGINT/SIGTERM: let the router stop and write its best result.
+// SA_RESETHAND makes a second one kill the process as usual.
+void onSignal(int sig) {
+    caughtSignal = sig;
+    requestStop();
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
-    if (argc != 7) {
+    const auto startTime = std::chrono::steady_clock::now();
+    std::string capFile, netFile, outFile, dumpFile, loadFile, convergenceFile;
+    RouterOptions options;
+    int checkpoint = 60;
+    GridLayout layout = GridLayout::Dense;
+    bool ok = true;
+    // simple argument parsing (TA implemented); values as "--opt v" or "--opt=v"
+    for (int i = 1; i < argc && ok; ++i) {
+        std::string opt = argv[i], val;
+        bool inlineVal = false;
+        size_t eq = opt.find('=');
+        if (opt.compare(0, 2, "--") == 0 && eq != std::string::npos) {
+            val = opt.substr(eq + 1);
+            opt.erase(eq);
+            inlineVal = true;
+        }
+        auto value = [&]() {
+            if (inlineVal) return true;
+            if (i + 1 >= argc) return false;
+            val = argv[++i];
+            return true;
+        };
+        auto number = [&](int &out, int lo) {
+            if (!value()) return false;
+            try {
+                size_t used = 0;
+                out = std::stoi(val, &used);
+                return used == val.size() && out >= lo;
+            } catch (const std::exception &) {
+                return false;
+            }
+        };
+        auto positive = [&](double &out) {
+            if (!value()) return false;
+            try {
+                size_t used = 0;
+                out = std::stod(val, &used);
+                return used == val.size() && out > 0;
+            } catch (const std::exception &) {
+                return false;
+            }
+        };
+        if (opt == "--profile") perf::Profiler::instance().enable();
+        else if (opt == "--cap") ok = value() && (capFile = val, true);
+        else if (opt == "--net") ok = value() && (netFile = val, true);
+        else if (opt == "--out") ok = value() && (outFile = val, true);
+        else if (opt == "--dump-snapshot") ok = value() && (dumpFile = val, true);
+        else if (opt == "--load-snapshot") ok = value() && (loadFile = val, true);
+        else if (opt == "--window") {
+            ok = value() && (val == "on" || val == "off");
+            options.window = val == "on";
+        }
+        else if (opt == "--window-margin") ok = number(options.windowMargin, 0);
+        else if (opt == "--window-growth") ok = number(options.windowGrowth, 2);
+        else if (opt == "--bidir-span") ok = number(options.bidirectionalSpan, -1);
+        else if (opt == "--pattern") {
+            ok = value() && (val == "on" || val == "off");
+            options.patternRoute = val == "on";
+        }
+        else if (opt == "--threads") ok = number(options.threads, 1);
+        else if (opt == "--batch-margin") ok = number(options.batchMargin, 0);
+        else if (opt == "--seed") {
+            int seed = 0;
+            ok = number(seed, 0);
+            options.seed = static_cast<unsigned>(seed);
+        }
+        else if (opt == "--portfolio")
+            ok = number(options.portfolio, 1) && options.portfolio <= RouterOptions::MAX_PORTFOLIO;
+        else if (opt == "--portfolio-grace") ok = number(options.portfolioGrace, 0);
+        else if (opt == "--time-budget") ok = positive(options.timeBudget);
+        else if (opt == "--checkpoint") ok = number(checkpoint, 0);
+        else if (opt == "--layout") {
+            ok = value() && (val == "dense" || val == "padded" || val == "tiled");
+            layout = val == "padded" ? GridLayout::Padded
+                   : val == "tiled" ? GridLayout::Tiled : GridLayout::Dense;
+        }
+        else if (opt == "--schedule") {
+            ok = value() && (val == "fixed" || val == "negotiated");
+            options.schedule = val == "negotiated" ? CostSchedule::Negotiated : CostSchedule::Fixed;
+        }
+        else if (opt == "--present-factor") ok = positive(options.presentFactor);
+        else if (opt == "--present-growth") ok = positive(options.presentGrowth);
+        else if (opt == "--history-beta") {
+            int beta = 0;
+            ok = number(beta, 0);
+            options.historyBeta = beta;
+        }
+        else if (opt == "--convergence-log") ok = value() && (convergenceFile = val, true);
+        else if (opt == "--queue") {
+            ok = value() && (val == "radix" || val == "binary");
+            options.radixHeap = val == "radix";
+        }
+        else ok = false;
+        if (!ok) std::cerr << "Error: bad or missing value for " << opt << "\n";
+    }
+    const bool haveInput = !loadFile.empty() || (!capFile.empty() && !netFile.empty());
+    if (!ok || !haveInput || (outFile.empty() && dumpFile.empty())) {
         std::cerr << "Usage: "
                   << argv[0]
-                  << " --cap case.cap --net case.net --out case.route\n";
+                  << " (--cap case.cap --net case.net | --load-snapshot case.snap)\n"
+                  << "       (--out case.route | --dump-snapshot case.snap) [--profile]\n"
+                  << "       [--window on|off] [--window-margin N] [--window-growth N]\n"
+                  << "       [--bidir-span N] [--queue radix|binary] [--layout dense|padded|tiled]\n"
+                  << "       [--pattern on|off] [--threads N] [--batch-margin N] [--seed N]\n"
+                  << "       [--portfolio K (at most 32, --threads at a time)] [--portfolio-grace N]\n"
+                  << "       [--schedule fixed|negotiated] [--present-factor X] [--present-growth X]\n"
+                  << "       [--history-beta N] [--convergence-log FILE]\n"
+                  << "       [--time-budget SECONDS] [--checkpoint SECONDS]\n";
         return 1;
     }
 
-    std::string capFile, netFile, outFile;
-    // simple argument parsing (TA implemented)
-    for (int i = 1; i < argc; i += 2) {
-        std::string opt = argv[i];
-        if (opt == "--cap") capFile = argv[i+1];
-        else if (opt == "--net") netFile = argv[i+1];
-        else if (opt == "--out") outFile = argv[i+1];
-    }
-
     ParsedInput input;
-    if (!parseInputFiles(capFile, netFile, input)) {
-        std::cerr << "Error: failed to parse input files.\n";
-        return 1;
+    {
+        perf::Scope scope("parse");
+        std::string error;
+        const bool loaded = loadFile.empty()
+            ? parseInputFiles(capFile, netFile, input, options.threads, &error)
+            : loadSnapshot(loadFile, input, &error);
+        if (!loaded) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+    }
+    if (layout != GridLayout::Dense) input.grid.setLayout(layout);
+    if (!dumpFile.empty()) {
+        std::string error;
+        if (!writeSnapshot(dumpFile, input, &error)) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        if (outFile.empty()) return 0;
     }
 
-    RoutingResult result = runRouting(input.grid, input.nets);
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sa.sa_flags = SA_RESETHAND;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    // the budget counts from program start; keep some of it for the output
+    const double parseSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    options.timeBudget -= parseSeconds + std::min(parseSeconds, 5.0);
+    options.checkpointPath = outFile;
+    options.checkpointInterval = checkpoint;
+
+    RoutingResult result = runRouting(input.grid, input.nets, options);
 
-    if (!writeRouteFile(outFile, result)) {
-        std::cerr << "Error: failed to write route file.\n";
+    {
+        perf::Scope scope("write");
+        if (!writeRouteFile(outFile, result, options.threads)) {
+            std::cerr << "Error: failed to write route file.\n";
+            return 1;
+        }
+    }
+
+    if (!convergenceFile.empty() && !writeConvergenceLog(convergenceFile, result)) {
+        std::cerr << "Error: failed to write " << convergenceFile << "\n";
         return 1;
     }
 
+    perf::Profiler::instance().report(std::cerr);
+    if (caughtSignal) {
+        std::cerr << "Stopped by signal " << caughtSignal << ", wrote best result to " << outFile << "\n";
+        return 128 + caughtSignal;
+    }
     return 0;
 }
@@ -0,0 +1,68 @@
+// mappedfile.h
+// Read-only view of a whole file: mmap'd when it is a regular file, read
+// into memory otherwise (a pipe, /dev/stdin).
+//
+//   MappedFile file(path);
+//   if (!file.ok()) ...;
+//   scan(file.begin(), file.end());
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0) {
+                ok_ = true;
+            } else {
+                void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, size_, MADV_SEQUENTIAL);
+                    mapped_ = static_cast<const char *>(p);
+                    ok_ = true;
+                }
+            }
+        }
+        if (!ok_) ok_ = readAll(fd);
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (mapped_) ::munmap(const_cast<char *>(mapped_), size_);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool ok() const { return ok_; }
+    const char *begin() const { return mapped_ ? mapped_ : copy_.data(); }
+    const char *end() const { return begin() + size(); }
+    size_t size() const { return mapped_ ? size_ : copy_.size(); }
+
+private:
+    bool readAll(int fd) {
+        copy_.clear();
+        char buf[1 << 16];
+        for (;;) {
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n == 0) return true;
+            if (n < 0) return false;
+            copy_.append(buf, static_cast<size_t>(n));
+        }
+    }
+
+    const char *mapped_ = nullptr;
+    size_t size_ = 0;
+    std::string copy_;
+    bool ok_ = false;
+};
+
+#endif // MAPPED_FILE_H
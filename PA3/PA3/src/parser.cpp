@@ -1,86 +1,302 @@
 // parser.cpp
+// Both files are mapped (or read whole when they can't be, e.g. a pipe) and
+// scanned in place: no getline, no substrings, no streams per line.  The
+// .net file is cut into chunks at net boundaries and the chunks are parsed
+// in parallel; with more than one thread the .cap file is parsed alongside.
 #include "parser.h"
+#include "mappedfile.h"
+#include "workerpool.h"
 #include <algorithm>
-#include <cctype>
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace {
 
-std::string trim(const std::string &s) {
+// the .net file is split only when every chunk gets at least this much
+constexpr size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string_view trim(std::string_view s) {
     size_t b = 0;
-    while (b < s.size() && std::isspace(static_cast<unsigned char>(s[b]))) ++b;
+    while (b < s.size() && isSpace(s[b])) ++b;
     size_t e = s.size();
-    while (e > b && std::isspace(static_cast<unsigned char>(s[e - 1]))) --e;
+    while (e > b && isSpace(s[e - 1])) --e;
     return s.substr(b, e - b);
 }
 
-bool parseCoordLine(const std::string &line, Coord3D &coord) {
-    std::istringstream iss(line);
-    char ch;
-    if (!(iss >> ch) || ch != '(') return false;
-    if (!(iss >> coord.layer)) return false;
-    if (!(iss >> ch) || ch != ',') return false;
-    if (!(iss >> coord.col)) return false;
-    if (!(iss >> ch) || ch != ',') return false;
-    if (!(iss >> coord.row)) return false;
-    if (!(iss >> ch) || ch != ')') return false;
-    return true;
+// from_chars, plus the leading '+' that operator>> accepts
+const char *scanInt(const char *p, const char *end, int &value) {
+    if (p < end && *p == '+' && p + 1 < end && *(p + 1) >= '0' && *(p + 1) <= '9') ++p;
+    auto [next, ec] = std::from_chars(p, end, value);
+    return ec == std::errc() ? next : nullptr;
+}
+
+/// Whitespace-separated tokens, the way operator>> reads them, counting lines.
+class TokenScanner {
+public:
+    TokenScanner(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+    int line() const { return line_; }
+
+    bool readInt(int &value) {
+        skipSpace();
+        const char *next = scanInt(p_, end_, value);
+        if (!next) return false;
+        p_ = next;
+        return true;
+    }
+    bool readWord(std::string_view &word) {
+        skipSpace();
+        const char *b = p_;
+        while (p_ < end_ && !isSpace(*p_)) ++p_;
+        word = std::string_view(b, p_ - b);
+        return !word.empty();
+    }
+
+private:
+    void skipSpace() {
+        while (p_ < end_ && isSpace(*p_)) {
+            if (*p_ == '\n') ++line_;
+            ++p_;
+        }
+    }
+
+    const char *p_;
+    const char *end_;
+    int line_ = 1;
+};
+
+/// Trimmed non-blank lines.
+class LineScanner {
+public:
+    LineScanner(const char *begin, const char *end) : p_(begin), end_(end) {}
+
+    // number of the last line returned, or of the last line when at the end
+    int line() const { return line_; }
+
+    bool next(std::string_view &out) {
+        while (p_ < end_) {
+            const char *nl = static_cast<const char *>(std::memchr(p_, '\n', end_ - p_));
+            const char *e = nl ? nl : end_;
+            std::string_view t = trim(std::string_view(p_, e - p_));
+            p_ = nl ? nl + 1 : end_;
+            ++line_;
+            if (!t.empty()) {
+                out = t;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    const char *p_;
+    const char *end_;
+    int line_ = 0;
+};
+
+// "(layer, col, row)" with any spacing; anything after the ')' is ignored
+bool parseCoordLine(std::string_view line, Coord3D &coord) {
+    const char *p = line.data(), *end = p + line.size();
+    auto expect = [&](char c) {
+        while (p < end && isSpace(*p)) ++p;
+        if (p == end || *p != c) return false;
+        ++p;
+        return true;
+    };
+    auto number = [&](int &value) {
+        while (p < end && isSpace(*p)) ++p;
+        p = scanInt(p, end, value);
+        return p != nullptr;
+    };
+    return expect('(') && number(coord.layer) && expect(',') && number(coord.col) &&
+           expect(',') && number(coord.row) && expect(')');
 }
 
-bool readNonEmptyLine(std::ifstream &fin, std::string &out) {
-    while (std::getline(fin, out)) {
-        std::string t = trim(out);
-        if (!t.empty()) {
-            out = t;
-            return true;
+void fail(std::string *error, const std::string &filename, int line, const char *what) {
+    if (error) *error = filename + ":" + std::to_string(line) + ": " + what;
+}
+
+std::string outsideGrid(const Grid &grid) {
+    return "pin outside the grid (layer 0-1, column 0-" + std::to_string(grid.xSize() - 1) +
+           ", row 0-" + std::to_string(grid.ySize() - 1) + ")";
+}
+
+// Nets from [begin, end) appended to nets; with grid, a pin outside it is
+// an error too.
+bool parseNets(
+    const char *begin,
+    const char *end,
+    const std::string &filename,
+    std::vector<Net> &nets,
+    std::string *error,
+    const Grid *grid = nullptr
+) {
+    LineScanner in(begin, end);
+    std::string_view line;
+    while (in.next(line)) {
+        if (line[0] == '#') continue;
+
+        Net net;
+        net.name.assign(line.data(), line.size());
+
+        if (!in.next(line) || line.find('(') == std::string_view::npos) {
+            fail(error, filename, in.line(), "expected '(' after the net name");
+            return false;
+        }
+
+        Coord3D pins[2];
+        for (int idx = 0; idx < 2; ++idx) {
+            if (!in.next(line) || !parseCoordLine(line, pins[idx])) {
+                fail(error, filename, in.line(), "expected a pin as (layer, col, row)");
+                return false;
+            }
+            if (grid && !grid->contains(pins[idx])) {
+                fail(error, filename, in.line(), outsideGrid(*grid).c_str());
+                return false;
+            }
         }
+
+        if (!in.next(line) || line.find(')') == std::string_view::npos) {
+            fail(error, filename, in.line(), "expected ')' after the pins");
+            return false;
+        }
+
+        net.pin1 = pins[0];
+        net.pin2 = pins[1];
+        nets.push_back(std::move(net));
     }
-    return false;
+    return true;
+}
+
+// Start of the first net at or after pos: the line after the next ")" line.
+const char *nextNetStart(const char *pos, const char *begin, const char *end) {
+    if (pos > begin && *(pos - 1) != '\n') {
+        const char *nl = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+        pos = nl ? nl + 1 : end;
+    }
+    while (pos < end) {
+        const char *nl = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+        const char *e = nl ? nl : end;
+        const bool close = trim(std::string_view(pos, e - pos)) == ")";
+        pos = nl ? nl + 1 : end;
+        if (close) return pos;
+    }
+    return end;
+}
+
+bool parseNetText(
+    const MappedFile &file,
+    const std::string &filename,
+    std::vector<Net> &nets,
+    int threads,
+    std::string *error
+) {
+    const char *begin = file.begin(), *end = file.end();
+    const size_t chunks = std::min<size_t>(
+        static_cast<size_t>(std::max(1, threads)) * 4, file.size() / MIN_CHUNK_BYTES);
+    if (threads <= 1 || chunks <= 1) return parseNets(begin, end, filename, nets, error);
+
+    std::vector<const char *> cut(chunks + 1);
+    cut[0] = begin;
+    cut[chunks] = end;
+    for (size_t k = 1; k < chunks; ++k)
+        cut[k] = std::max(cut[k - 1], nextNetStart(begin + file.size() * k / chunks, begin, end));
+
+    std::vector<std::vector<Net>> parts(chunks);
+    std::vector<char> ok(chunks, 1);
+    WorkerPool pool(threads);
+    pool.run(chunks, [&](size_t k, int) {
+        ok[k] = parseNets(cut[k], cut[k + 1], filename, parts[k], nullptr);
+    });
+
+    // a chunk that fails may just have been cut in the wrong place (a net
+    // named ")"); the serial parse settles it and numbers the error lines
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+        return parseNets(begin, end, filename, nets, error);
+
+    size_t total = nets.size();
+    for (const auto &part : parts) total += part.size();
+    nets.reserve(total);
+    for (auto &part : parts)
+        std::move(part.begin(), part.end(), std::back_inserter(nets));
+    return true;
 }
 
 } // namespace
 
-bool parseCapFile(const std::string &filename, Grid &grid) {
-    std::ifstream fin(filename);
-    if (!fin) return false;
+bool parseCapFile(const std::string &filename, Grid &grid, std::string *error) {
+    MappedFile file(filename);
+    if (!file.ok()) {
+        if (error) *error = filename + ": cannot read the file";
+        return false;
+    }
+    TokenScanner in(file.begin(), file.end());
 
     int numLayers = 0;
     int xSize = 0;
     int ySize = 0;
-    if (!(fin >> numLayers >> xSize >> ySize)) return false;
-    if (numLayers != 2) return false;
+    if (!in.readInt(numLayers) || !in.readInt(xSize) || !in.readInt(ySize)) {
+        fail(error, filename, in.line(), "expected the layer count and grid size");
+        return false;
+    }
+    if (numLayers != 2) {
+        fail(error, filename, in.line(), "only 2 layers are supported");
+        return false;
+    }
 
     grid.resize(xSize, ySize);
 
     int viaCost = 0;
-    if (!(fin >> viaCost)) return false;
+    if (!in.readInt(viaCost)) {
+        fail(error, filename, in.line(), "expected the via cost");
+        return false;
+    }
     grid.setViaCost(viaCost);
 
     std::vector<int> horizontal(std::max(0, xSize - 1));
     for (int j = 0; j < xSize - 1; ++j) {
-        if (!(fin >> horizontal[j])) return false;
+        if (!in.readInt(horizontal[j])) {
+            fail(error, filename, in.line(), "expected a horizontal distance");
+            return false;
+        }
     }
     grid.setHorizontalDistances(horizontal);
 
     std::vector<int> vertical(std::max(0, ySize - 1));
     for (int i = 0; i < ySize - 1; ++i) {
-        if (!(fin >> vertical[i])) return false;
+        if (!in.readInt(vertical[i])) {
+            fail(error, filename, in.line(), "expected a vertical distance");
+            return false;
+        }
     }
     grid.setVerticalDistances(vertical);
 
     for (int l = 0; l < numLayers; ++l) {
-        std::string layerName;
-        std::string dir;
-        if (!(fin >> layerName >> dir)) return false;
-        LayerInfo info{layerName, dir.empty() ? 'H' : dir[0]};
+        std::string_view layerName;
+        std::string_view dir;
+        if (!in.readWord(layerName) || !in.readWord(dir)) {
+            fail(error, filename, in.line(), "expected a layer name and direction");
+            return false;
+        }
+        LayerInfo info{std::string(layerName), dir[0]};
         grid.setLayerInfo(l, info);
 
         for (int row = 0; row < ySize; ++row) {
             for (int col = 0; col < xSize; ++col) {
                 int cap = 0;
-                if (!(fin >> cap)) return false;
+                if (!in.readInt(cap)) {
+                    fail(error, filename, in.line(), "expected a capacity");
+                    return false;
+                }
                 grid.setCapacity(l, col, row, cap);
             }
         }
@@ -90,47 +306,55 @@ bool parseCapFile(const std::string &filename, Grid &grid) {
     return true;
 }
 
-bool parseNetFile(const std::string &filename, std::vector<Net> &nets) {
-    std::ifstream fin(filename);
-    if (!fin) return false;
-
-    std::string line;
-    while (readNonEmptyLine(fin, line)) {
-        if (!line.empty() && line[0] == '#') continue;
-
-        Net net;
-        net.name = line;
-
-        if (!readNonEmptyLine(fin, line) || line.find('(') == std::string::npos)
-            return false;
-
-        Coord3D pins[2];
-        for (int idx = 0; idx < 2; ++idx) {
-            if (!readNonEmptyLine(fin, line)) return false;
-            if (!parseCoordLine(line, pins[idx])) return false;
-        }
-
-        if (!readNonEmptyLine(fin, line) || line.find(')') == std::string::npos)
-            return false;
-
-        net.pin1 = pins[0];
-        net.pin2 = pins[1];
-        nets.push_back(net);
+bool parseNetFile(
+    const std::string &filename,
+    std::vector<Net> &nets,
+    int threads,
+    std::string *error
+) {
+    MappedFile file(filename);
+    if (!file.ok()) {
+        if (error) *error = filename + ": cannot read the file";
+        return false;
     }
-
-    return true;
+    return parseNetText(file, filename, nets, threads, error);
 }
 
 bool parseInputFiles(
     const std::string &capFilename,
     const std::string &netFilename,
-    ParsedInput &out
+    ParsedInput &out,
+    int threads,
+    std::string *error
 ) {
     Grid grid;
     std::vector<Net> nets;
+    std::string capError, netError;
+    bool capOk = false, netOk = false;
 
-    if (!parseCapFile(capFilename, grid)) return false;
-    if (!parseNetFile(netFilename, nets)) return false;
+    if (threads > 1) {
+        std::thread cap([&] { capOk = parseCapFile(capFilename, grid, &capError); });
+        netOk = parseNetFile(netFilename, nets, threads - 1, &netError);
+        cap.join();
+    } else {
+        capOk = parseCapFile(capFilename, grid, &capError);
+        netOk = capOk && parseNetFile(netFilename, nets, 1, &netError);
+    }
+    if (!capOk || !netOk) {
+        if (error) *error = capOk ? netError : capError;
+        return false;
+    }
+    // the nets were parsed without the grid; if a pin is off it, parse the
+    // file once more against the grid to find the line
+    for (const Net &net : nets) {
+        if (grid.contains(net.pin1) && grid.contains(net.pin2)) continue;
+        MappedFile file(netFilename);
+        std::vector<Net> again;
+        if (!file.ok() || parseNets(file.begin(), file.end(), netFilename, again, error, &grid)) {
+            if (error) *error = netFilename + ": net " + net.name + ": " + outsideGrid(grid);
+        }
+        return false;
+    }
 
     out.grid = std::move(grid);
     out.nets = std::move(nets);
@@ -12,14 +12,24 @@ struct ParsedInput {
     std::vector<Net> nets;
 };
 
-bool parseCapFile(const std::string &filename, Grid &grid);
-bool parseNetFile(const std::string &filename, std::vector<Net> &nets);
+// On failure *error (when given) says where: "case.net:12: expected ...".
+bool parseCapFile(const std::string &filename, Grid &grid, std::string *error = nullptr);
+/// Parses chunks of the file on up to `threads` threads; the nets come out
+/// in file order whatever the thread count.
+bool parseNetFile(
+    const std::string &filename,
+    std::vector<Net> &nets,
+    int threads = 1,
+    std::string *error = nullptr
+);
 
-/// Convenience wrapper: parse both files.
+/// Convenience wrapper: parse both files, side by side when threads > 1.
 bool parseInputFiles(
     const std::string &capFilename,
     const std::string &netFilename,
-    ParsedInput &out
+    ParsedInput &out,
+    int threads = 1,
+    std::string *error = nullptr
 );
 
 #endif // PARSER_H
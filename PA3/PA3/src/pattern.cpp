@@ -0,0 +1,215 @@
+// pattern.cpp
+#include "pattern.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <initializer_list>
+
+PatternRouter::PatternRouter(const Grid &grid, const std::vector<long long> &costs)
+    : grid_(&grid), costs_(&costs), xSize_(grid.xSize()), ySize_(grid.ySize()) {
+    for (int l = 0; l < grid.numLayers(); ++l) dir_[l] = grid.layerInfo(l).direction;
+    lineStride_ = std::max(xSize_, ySize_);
+    lines_.resize(grid.numLayers() * lineStride_);
+}
+
+bool PatternRouter::isFull(int idx) const {
+    return grid_->demandAt(idx) >= grid_->capacityAt(idx);
+}
+
+// Linear-time build: drop every value in its slot, then push each slot's
+// partial sum up to its Fenwick parent.
+const PatternRouter::Line &PatternRouter::ensureLine(int l, int line) const {
+    Line &ln = lines_[l * lineStride_ + line];
+    if (!ln.costTree.empty()) return ln;
+    const bool horizontal = dir_[l] == 'H';
+    const int len = horizontal ? xSize_ : ySize_;
+    ln.costTree.assign(len + 1, 0);
+    ln.fullTree.assign(len + 1, 0);
+    ln.heldCost.resize(len);
+    ln.heldFull.resize(len);
+    for (int p = 1; p <= len; ++p) {
+        const int idx = horizontal ? grid_->indexOf(l, p - 1, line) : grid_->indexOf(l, line, p - 1);
+        ln.heldCost[p - 1] = (*costs_)[idx];
+        ln.heldFull[p - 1] = isFull(idx);
+        ln.costTree[p] = ln.heldCost[p - 1];
+        ln.fullTree[p] = ln.heldFull[p - 1];
+    }
+    for (int p = 1; p <= len; ++p) {
+        const int parent = p + (p & -p);
+        if (parent > len) continue;
+        ln.costTree[parent] += ln.costTree[p];
+        ln.fullTree[parent] += ln.fullTree[p];
+    }
+    return ln;
+}
+
+void PatternRouter::update(const std::vector<int> &cells) {
+    for (int idx : cells) {
+        const Coord3D c = grid_->coordOf(idx);
+        const int l = c.layer, i = c.row, j = c.col;
+        Line &ln = lines_[l * lineStride_ + lineOf(l, j, i)];
+        if (ln.costTree.empty()) continue;  // read when the line gets built
+        const int pos = dir_[l] == 'H' ? j : i;
+        const long long dCost = (*costs_)[idx] - ln.heldCost[pos];
+        const int dFull = int(isFull(idx)) - int(ln.heldFull[pos]);
+        if (dCost == 0 && dFull == 0) continue;
+        ln.heldCost[pos] += dCost;
+        ln.heldFull[pos] = static_cast<unsigned char>(ln.heldFull[pos] + dFull);
+        const int len = static_cast<int>(ln.heldCost.size());
+        for (int p = pos + 1; p <= len; p += p & -p) {
+            ln.costTree[p] += dCost;
+            ln.fullTree[p] += dFull;
+        }
+    }
+}
+
+PatternRouter::Tally PatternRouter::lineSum(int l, int line, int lo, int hi,
+                                            const PinLine *pinLines) const {
+    Tally t;
+    for (int k = 0; k < 4; ++k) {
+        const PinLine &pl = pinLines[k];
+        if (pl.layer != l || pl.line != line || lo < pl.lo
+            || hi - pl.lo + 1 >= static_cast<int>(pl.cost.size())) continue;
+        t.cost = pl.cost[hi - pl.lo + 1] - pl.cost[lo - pl.lo];
+        t.full = pl.full[hi - pl.lo + 1] - pl.full[lo - pl.lo];
+        return t;
+    }
+    const int len = dir_[l] == 'H' ? xSize_ : ySize_;
+    if (lines_[l * lineStride_ + line].costTree.empty() && 4 * (hi - lo + 1) < len) {
+        // short range on a line nobody has built: cheaper to add it up
+        for (int k = lo; k <= hi; ++k) {
+            const int idx = dir_[l] == 'H' ? grid_->indexOf(l, k, line) : grid_->indexOf(l, line, k);
+            t.cost += (*costs_)[idx];
+            t.full += isFull(idx);
+        }
+        return t;
+    }
+    const Line &ln = ensureLine(l, line);
+    for (int p = hi + 1; p > 0; p -= p & -p) {
+        t.cost += ln.costTree[p];
+        t.full += ln.fullTree[p];
+    }
+    for (int p = lo; p > 0; p -= p & -p) {
+        t.cost -= ln.costTree[p];
+        t.full -= ln.fullTree[p];
+    }
+    return t;
+}
+
+void PatternRouter::fillPinLine(PinLine &pl, int l, int line, int lo, int hi) const {
+    pl.layer = l;
+    pl.line = line;
+    pl.lo = lo;
+    pl.cost.assign(1, 0);
+    pl.full.assign(1, 0);
+    for (int k = lo; k <= hi; ++k) {
+        const int idx = dir_[l] == 'H' ? grid_->indexOf(l, k, line) : grid_->indexOf(l, line, k);
+        pl.cost.push_back(pl.cost.back() + (*costs_)[idx]);
+        pl.full.push_back(pl.full.back() + isFull(idx));
+    }
+}
+
+// Cost of the route through corners, every gcell after the first one
+// counted once; false if a leg runs against its layer's direction.
+bool PatternRouter::evaluate(const Shape &corners, const PinLine *pinLines, Tally &t) const {
+    const Grid &grid = *grid_;
+    t = Tally();
+    for (int k = 1; k < corners.size; ++k) {
+        const Corner &a = corners.at[k - 1], &b = corners.at[k];
+        if (a.layer != b.layer) {
+            const int idx = grid.indexOf(b.layer, b.col, b.row);
+            t.cost += grid.wlViaCost() + (*costs_)[idx];
+            t.full += isFull(idx);
+            continue;
+        }
+        const bool horizontal = a.row == b.row;
+        if ((dir_[a.layer] == 'H') != horizontal) return false;
+        int from, to;
+        if (horizontal) {
+            t.cost += std::llabs(grid.colPosition(a.col) - grid.colPosition(b.col));
+            from = a.col;
+            to = b.col;
+        } else {
+            t.cost += std::llabs(grid.rowPosition(a.row) - grid.rowPosition(b.row));
+            from = a.row;
+            to = b.row;
+        }
+        // gcells strictly after a up to and including b
+        const int line = lineOf(a.layer, a.col, a.row);
+        Tally s = from < to ? lineSum(a.layer, line, from + 1, to, pinLines)
+                            : lineSum(a.layer, line, to, from - 1, pinLines);
+        t.cost += s.cost;
+        t.full += s.full;
+    }
+    return true;
+}
+
+std::vector<Coord3D> PatternRouter::route(const Net &net) const {
+    const Grid &grid = *grid_;
+    if (dir_[0] == dir_[1]) return {};
+    const int hLayer = dir_[0] == 'H' ? 0 : 1;
+    const Coord3D &s = net.pin1, &t = net.pin2;
+    const int cLo = std::min(s.col, t.col), cHi = std::max(s.col, t.col);
+    const int rLo = std::min(s.row, t.row), rHi = std::max(s.row, t.row);
+
+    PinLine pinLines[4];
+    fillPinLine(pinLines[0], hLayer, s.row, cLo, cHi);
+    fillPinLine(pinLines[1], hLayer, t.row, cLo, cHi);
+    fillPinLine(pinLines[2], 1 - hLayer, s.col, rLo, rHi);
+    fillPinLine(pinLines[3], 1 - hLayer, t.col, rLo, rHi);
+
+    // legs: 'H' moves to a column on the H layer, 'V' to a row on the V layer;
+    // zero-length legs are dropped, vias are added where the layer changes
+    auto shape = [&](std::initializer_list<std::pair<char, int>> legs, Shape &corners) {
+        corners.size = 0;
+        corners.push({s.layer, s.col, s.row});
+        for (const auto &[axis, value] : legs) {
+            Corner c = corners.back();
+            if ((axis == 'H' ? c.col : c.row) == value) continue;
+            const int layer = axis == 'H' ? hLayer : 1 - hLayer;
+            if (c.layer != layer) {
+                c.layer = layer;
+                corners.push(c);
+            }
+            (axis == 'H' ? c.col : c.row) = value;
+            corners.push(c);
+        }
+        if (corners.back().layer != t.layer) corners.push({t.layer, t.col, t.row});
+    };
+
+    const int pinFull = isFull(grid.gcellIndex(t.layer, t.col, t.row));
+    Shape best, cand;
+    long long bestCost = LLONG_MAX;
+    auto consider = [&](std::initializer_list<std::pair<char, int>> legs) {
+        shape(legs, cand);
+        Tally tally;
+        if (!evaluate(cand, pinLines, tally) || tally.full > pinFull) return;
+        if (tally.cost < bestCost) {
+            bestCost = tally.cost;
+            best = cand;
+        }
+    };
+    consider({{'H', t.col}, {'V', t.row}});  // L shapes
+    consider({{'V', t.row}, {'H', t.col}});
+    for (int c = cLo + 1; c < cHi; ++c)  // Z: H-V-H
+        consider({{'H', c}, {'V', t.row}, {'H', t.col}});
+    for (int r = rLo + 1; r < rHi; ++r)  // Z: V-H-V
+        consider({{'V', r}, {'H', t.col}, {'V', t.row}});
+    if (bestCost == LLONG_MAX) return {};
+
+    std::vector<Coord3D> path{s};
+    for (int k = 1; k < best.size; ++k) {
+        const Corner &b = best.at[k];
+        Coord3D cur = path.back();
+        if (cur.layer != b.layer) {
+            cur.layer = b.layer;
+            path.push_back(cur);
+        }
+        while (cur.col != b.col || cur.row != b.row) {
+            if (cur.col != b.col) cur.col += cur.col < b.col ? 1 : -1;
+            else cur.row += cur.row < b.row ? 1 : -1;
+            path.push_back(cur);
+        }
+    }
+    return path;
+}
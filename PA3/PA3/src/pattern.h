@@ -0,0 +1,76 @@
+// pattern.h
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include "grid.h"
+#include "types.h"
+#include <vector>
+
+/// L- and Z-shaped routes evaluated in O(log) per straight leg.  For every
+/// line along a layer's preferred direction (a row on an H layer, a column
+/// on a V layer) two Fenwick trees hold the vertex cost and the number of
+/// full gcells (demand >= capacity), so a leg's cost is two prefix queries.
+/// A line's trees are built the first time a query reaches it and then
+/// follow the cost map through update(); everything else is read live from
+/// the grid and the cost vector, which must outlive the router.
+class PatternRouter {
+public:
+    PatternRouter(const Grid &grid, const std::vector<long long> &costs);
+
+    /// Re-reads cost and fullness of the given gcells.
+    void update(const std::vector<int> &cells);
+
+    /// Cheapest L/Z route of net under the astar() cost model that crosses
+    /// no full gcell other than the pins, one Coord3D per gcell from pin1 to
+    /// pin2; {} if every pattern crosses a full gcell.
+    std::vector<Coord3D> route(const Net &net) const;
+
+private:
+    struct Corner {
+        int layer, col, row;
+    };
+    // corners of one candidate: pin, at most three legs with a via each, pin
+    struct Shape {
+        Corner at[8];
+        int size = 0;
+        void push(const Corner &c) { at[size++] = c; }
+        const Corner &back() const { return at[size - 1]; }
+    };
+    struct Tally {
+        long long cost = 0;
+        int full = 0;
+    };
+    // Plain prefix sums of the pins' own rows and columns over the net's
+    // bounding box, built per route() call: every L/Z candidate runs two of
+    // its three legs along these, so only the middle leg needs the trees.
+    struct PinLine {
+        int layer = -1, line = -1, lo = 0;
+        std::vector<long long> cost;  // cost[k] = sum over positions [lo, lo + k)
+        std::vector<int> full;
+    };
+
+    // Fenwick trees of one line (1-based, len + 1 slots) and, per position,
+    // the values they hold so update() can apply deltas
+    struct Line {
+        std::vector<long long> costTree;
+        std::vector<int> fullTree;
+        std::vector<long long> heldCost;
+        std::vector<unsigned char> heldFull;
+    };
+
+    bool isFull(int idx) const;
+    int lineOf(int l, int j, int i) const { return dir_[l] == 'H' ? i : j; }
+    const Line &ensureLine(int l, int line) const;
+    Tally lineSum(int l, int line, int lo, int hi, const PinLine *pinLines) const;  // [lo, hi]
+    void fillPinLine(PinLine &pl, int l, int line, int lo, int hi) const;
+    bool evaluate(const Shape &corners, const PinLine *pinLines, Tally &t) const;
+
+    const Grid *grid_;
+    const std::vector<long long> *costs_;
+    int xSize_ = 0, ySize_ = 0;
+    char dir_[2] = {'H', 'V'};
+    int lineStride_ = 0;               // lines_ index = l * lineStride_ + line
+    mutable std::vector<Line> lines_;  // empty until first used
+};
+
+#endif // PATTERN_H
@@ -0,0 +1,131 @@
+// pqueue.h
+// Min-priority queues of (key, vertex) for the searches in graph.cpp.  Both
+// share one interface so a search can take the queue as a template
+// parameter:
+//
+//   reset(numVertices)  empty the queue for a new search
+//   push(key, v)        keys are >= 0; pushing a vertex again is fine
+//                       (lazy deletion, the search skips stale entries)
+//   pop()               smallest (key, vertex) entry
+//   topKey()            key of the entry pop() would return
+//   normalize(key)      the key as stored, for the stale-entry test
+#ifndef PQUEUE_H
+#define PQUEUE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// std::push_heap / pop_heap over 16-byte (key, vertex) pairs; ties pop the
+/// smaller vertex first.
+class BinaryHeap {
+public:
+    using Entry = std::pair<long long, int>;
+
+    void reset(int /*numVertices*/) { heap_.clear(); }
+    bool empty() const { return heap_.empty(); }
+    size_t size() const { return heap_.size(); }
+    long long normalize(long long key) const { return key; }
+
+    void push(long long key, int v) {
+        heap_.push_back({key, v});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+    }
+    long long topKey() const { return heap_.front().first; }
+    Entry pop() {
+        std::pop_heap(heap_.begin(), heap_.end(), std::greater<Entry>());
+        Entry e = heap_.back();
+        heap_.pop_back();
+        return e;
+    }
+
+private:
+    std::vector<Entry> heap_;
+};
+
+/// Radix heap for monotone keys: every pushed key must be at least the last
+/// popped one, which holds for Dijkstra and for A* with a consistent
+/// heuristic.  An entry is one 64-bit word, key << vertexBits | vertex, kept
+/// in the bucket of the highest bit in which its key differs from the last
+/// popped key; a pop only redistributes the first non-empty bucket, so each
+/// entry moves at most 64 times.  Keys beyond the bits left over after the
+/// vertex (2^44 with a million vertices) are clamped, so their relative order
+/// is lost; the negotiated present costs are capped to stay below that
+/// (maxPresentCost in costmap.h).
+class RadixHeap {
+public:
+    using Entry = std::pair<long long, int>;
+
+    /// Largest key kept exactly in a queue reset for numVertices; larger
+    /// ones are clamped to it.
+    static long long maxExactKey(int numVertices) {
+        return static_cast<long long>((uint64_t(1) << (64 - bitsFor(numVertices))) - 1);
+    }
+
+    void reset(int numVertices) {
+        vertexBits_ = bitsFor(numVertices);
+        vertexMask_ = (uint64_t(1) << vertexBits_) - 1;
+        maxKey_ = static_cast<uint64_t>(maxExactKey(numVertices));
+        for (auto &b : buckets_) b.clear();
+        size_ = 0;
+        last_ = 0;
+    }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    long long normalize(long long key) const {
+        return static_cast<uint64_t>(key) < maxKey_ ? key : static_cast<long long>(maxKey_);
+    }
+
+    void push(long long key, int v) {
+        uint64_t k = static_cast<uint64_t>(normalize(key));
+        assert(key >= 0 && k >= last_);
+        buckets_[bucketOf(k)].push_back(k << vertexBits_ | static_cast<uint64_t>(v));
+        ++size_;
+    }
+    long long topKey() {
+        pull();
+        return static_cast<long long>(last_);
+    }
+    Entry pop() {
+        pull();
+        uint64_t e = buckets_[0].back();
+        buckets_[0].pop_back();
+        --size_;
+        return {static_cast<long long>(e >> vertexBits_), static_cast<int>(e & vertexMask_)};
+    }
+
+private:
+    static int bitsFor(int numVertices) {
+        int bits = 1;
+        while (bits < 32 && (1LL << bits) < numVertices) ++bits;
+        return bits;
+    }
+
+    int bucketOf(uint64_t key) const {
+        return key == last_ ? 0 : 64 - __builtin_clzll(key ^ last_);
+    }
+
+    // make bucket 0 non-empty: advance last_ to the smallest key of the
+    // first non-empty bucket and spread that bucket over the lower ones
+    void pull() {
+        if (!buckets_[0].empty()) return;
+        int i = 1;
+        while (buckets_[i].empty()) ++i;
+        std::vector<uint64_t> &from = buckets_[i];
+        last_ = *std::min_element(from.begin(), from.end()) >> vertexBits_;
+        for (uint64_t e : from) buckets_[bucketOf(e >> vertexBits_)].push_back(e);
+        from.clear();
+    }
+
+    std::vector<uint64_t> buckets_[65];
+    size_t size_ = 0;
+    uint64_t last_ = 0;
+    int vertexBits_ = 1;
+    uint64_t vertexMask_ = 1;
+    uint64_t maxKey_ = 0;
+};
+
+#endif // PQUEUE_H
@@ -1,40 +1,277 @@
 // router.cpp
 #include "router.h"
+#include "costmap.h"
+#include "pattern.h"
+#include "workerpool.h"
+#include "perfScope.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 namespace {
 
 constexpr int OVERFLOW_WEIGHT = 100000;
-
-int totalVertices(const Grid &grid) {
-    return grid.numLayers() * grid.xSize() * grid.ySize();
-}
+// portfolio history weights: at most 2^16 times the base either way, and
+// never scaled up past 2^24 (a base beyond that is kept as is)
+constexpr int MAX_BETA_SHIFT = 16;
+constexpr long long MAX_SCALED_BETA = 1LL << 24;
 
 std::vector<Coord3D> reconstructPath(
     const Grid &grid,
     int sourceIdx,
     int targetIdx,
-    const std::vector<int> &prev
+    const SearchWorkspace &ws
 ) {
     if (sourceIdx < 0 || targetIdx < 0) return {};
     int cur = targetIdx;
     std::vector<Coord3D> path;
     while(cur != -1 && cur != sourceIdx){
-        if(cur < 0 || cur >= static_cast<int>(prev.size())) return {};
-        path.push_back(grid.fromIndex(cur));
-        cur = prev[cur];
+        path.push_back(grid.coordOf(cur));
+        cur = ws.prev(cur);
     }
      if(cur == -1)return {};
-    path.push_back(grid.fromIndex(sourceIdx));
+    path.push_back(grid.coordOf(sourceIdx));
     std::reverse(path.begin(), path.end());
     return path;
 }
 
+// Path from a bidirectional search: fwd.prev() back from meet to the source,
+// then bwd.prev() forward from meet to the target.
+std::vector<Coord3D> reconstructPath(
+    const Grid &grid,
+    int sourceIdx,
+    int targetIdx,
+    const SearchWorkspace &fwd,
+    const SearchWorkspace &bwd,
+    int meet
+) {
+    std::vector<Coord3D> path = reconstructPath(grid, sourceIdx, meet, fwd);
+    if (path.empty()) return {};
+    for (int cur = meet; cur != targetIdx; ) {
+        cur = bwd.prev(cur);
+        if (cur == -1) return {};
+        path.push_back(grid.coordOf(cur));
+    }
+    return path;
+}
+
+// A* state reused by every search of a routing run.
+struct SearchState {
+    SearchWorkspace fwd;
+    SearchWorkspace bwd;  // reverse half of bidirectional searches
+};
+
+// Best src-dst path in g under costs into path; returns its cost (INF and
+// an empty path if there is none).  Nets spanning at least
+// options.bidirectionalSpan gcells use the bidirectional search.
+template <typename QueueT>
+long long findPath(
+    const GridGraph &g,
+    const Grid &grid,
+    const Net &net,
+    const std::vector<long long> &costs,
+    SearchState &state,
+    const RouterOptions &options,
+    std::vector<Coord3D> &path,
+    long long &touched
+) {
+    const int src = grid.gcellIndex(net.pin1.layer, net.pin1.col, net.pin1.row);
+    const int dst = grid.gcellIndex(net.pin2.layer, net.pin2.col, net.pin2.row);
+    const int span = std::abs(net.pin1.col - net.pin2.col) + std::abs(net.pin1.row - net.pin2.row);
+    long long cost;
+    path.clear();
+    if (options.bidirectionalSpan >= 0 && span >= options.bidirectionalSpan) {
+        int meet = -1;
+        cost = bidirectionalAstar<GridGraph, QueueT>(g, grid, src, dst, costs, state.fwd, state.bwd, meet);
+        touched += static_cast<long long>(state.fwd.touched().size() + state.bwd.touched().size());
+        if (cost < INF) path = reconstructPath(grid, src, dst, state.fwd, state.bwd, meet);
+    } else {
+        cost = astar<GridGraph, QueueT>(g, grid, src, dst, costs, state.fwd);
+        touched += static_cast<long long>(state.fwd.touched().size());
+        if (cost < INF) path = reconstructPath(grid, src, dst, state.fwd);
+    }
+    return cost;
+}
+
+long long findPath(
+    const GridGraph &g,
+    const Grid &grid,
+    const Net &net,
+    const std::vector<long long> &costs,
+    SearchState &state,
+    const RouterOptions &options,
+    std::vector<Coord3D> &path,
+    long long &touched
+) {
+    if (options.radixHeap)
+        return findPath<RadixHeap>(g, grid, net, costs, state, options, path, touched);
+    return findPath<BinaryHeap>(g, grid, net, costs, state, options, path, touched);
+}
+
+SearchWindow windowAround(const Grid &grid, const Net &net, int margin) {
+    SearchWindow w;
+    w.colLo = std::max(0, std::min(net.pin1.col, net.pin2.col) - margin);
+    w.colHi = std::min(grid.xSize() - 1, std::max(net.pin1.col, net.pin2.col) + margin);
+    w.rowLo = std::max(0, std::min(net.pin1.row, net.pin2.row) - margin);
+    w.rowHi = std::min(grid.ySize() - 1, std::max(net.pin1.row, net.pin2.row) + margin);
+    return w;
+}
+
+// Lower bound on the cost of any pin-to-pin path that leaves window w.  Such
+// a path has to reach a column (row) just outside w and come back, adding
+// twice that detour to the pin distance; vertex costs are never negative.
+long long escapeBound(const Grid &grid, const Net &net, const SearchWindow &w) {
+    const int cLo = std::min(net.pin1.col, net.pin2.col);
+    const int cHi = std::max(net.pin1.col, net.pin2.col);
+    const int rLo = std::min(net.pin1.row, net.pin2.row);
+    const int rHi = std::max(net.pin1.row, net.pin2.row);
+    long long detour = INF;
+    if (w.colLo > 0)
+        detour = std::min(detour, grid.colPosition(cLo) - grid.colPosition(w.colLo - 1));
+    if (w.colHi < grid.xSize() - 1)
+        detour = std::min(detour, grid.colPosition(w.colHi + 1) - grid.colPosition(cHi));
+    if (w.rowLo > 0)
+        detour = std::min(detour, grid.rowPosition(rLo) - grid.rowPosition(w.rowLo - 1));
+    if (w.rowHi < grid.ySize() - 1)
+        detour = std::min(detour, grid.rowPosition(w.rowHi + 1) - grid.rowPosition(rHi));
+    if (detour == INF) return INF;
+    return manhattanDistance(grid, net.pin1, net.pin2) + 2 * detour;
+}
+
+// True if routing path would push some gcell past its capacity.
+bool addsOverflow(const Grid &grid, const std::vector<Coord3D> &path) {
+    for (const Coord3D &c : path) {
+        int idx = grid.indexOf(c.layer, c.col, c.row);
+        if (grid.demandAt(idx) >= grid.capacityAt(idx)) return true;
+    }
+    return false;
+}
+
+// One net's shortest path under costs, or {} if there is none.  With
+// windows on, the search starts in the pin bounding box plus the margin and
+// only widens when nothing is found, or when the path adds overflow and its
+// cost could still be beaten outside the window.
+std::vector<Coord3D> searchNet(
+    const Grid &grid,
+    const Net &net,
+    const std::vector<long long> &costs,
+    SearchState &state,
+    const RouterOptions &options,
+    WindowStats *stats
+) {
+    std::vector<Coord3D> path;
+    long long touched = 0;
+    if (!options.window) {
+        findPath(GridGraph(grid), grid, net, costs, state, options, path, touched);
+        return path;
+    }
+
+    WindowStats st;
+    long long margin = std::max(0, options.windowMargin);
+    const int growth = std::max(2, options.windowGrowth);
+    const long long maxSpan = std::max(grid.xSize(), grid.ySize());
+    while (true) {
+        const SearchWindow w = windowAround(grid, net, static_cast<int>(std::min(margin, maxSpan)));
+        const bool whole = w.coversGrid(grid);
+        long long cost = findPath(GridGraph(grid, w), grid, net, costs, state, options, path, st.touched);
+        ++st.windows;
+        if (cost < INF) {
+            if (whole || cost < escapeBound(grid, net, w) || !addsOverflow(grid, path)) {
+                st.width = w.width();
+                st.height = w.height();
+                st.fullGrid = whole && st.windows > 1;
+                break;
+            }
+            path.clear();
+        }
+        if (whole) {
+            st.fullGrid = true;
+            break;
+        }
+        margin = std::max(1LL, margin) * growth;
+    }
+    if (stats) *stats = st;
+    return path;
+}
+
+// One net's path inside w only, for a parallel batch: its nets search their
+// own disjoint windows, so none of them reads a cost that another is about
+// to change.  Returns {} when there is no path in w, or when the path adds
+// overflow and a path leaving w might be cheaper; such a net has to be
+// searched over the whole grid.
+std::vector<Coord3D> searchInWindow(
+    const Grid &grid,
+    const Net &net,
+    const std::vector<long long> &costs,
+    SearchState &state,
+    const RouterOptions &options,
+    const SearchWindow &w,
+    WindowStats *stats
+) {
+    std::vector<Coord3D> path;
+    WindowStats st;
+    const long long cost = findPath(GridGraph(grid, w), grid, net, costs, state, options, path, st.touched);
+    if (cost < INF && !w.coversGrid(grid) && cost >= escapeBound(grid, net, w) && addsOverflow(grid, path))
+        path.clear();
+    st.windows = 1;
+    st.width = w.width();
+    st.height = w.height();
+    st.fullGrid = w.coversGrid(grid);
+    if (stats) *stats = st;
+    return path;
+}
+
+// Splits nets (in priority order) into batches whose pin bounding boxes,
+// grown by margin gcells, are pairwise disjoint: greedy coloring of the
+// overlap graph, each net going to the first batch it fits in.
+std::vector<std::vector<int>> conflictFreeBatches(
+    const Grid &grid,
+    const std::vector<Net> &nets,
+    const std::vector<int> &order,
+    int margin
+) {
+    std::vector<std::vector<int>> batches;
+    std::vector<std::vector<SearchWindow>> boxes;
+    for (int netId : order) {
+        const SearchWindow w = windowAround(grid, nets[netId], margin);
+        size_t b = 0;
+        for (; b < batches.size(); ++b) {
+            bool clash = false;
+            for (const SearchWindow &o : boxes[b]) {
+                if (w.colLo <= o.colHi && o.colLo <= w.colHi && w.rowLo <= o.rowHi && o.rowLo <= w.rowHi) {
+                    clash = true;
+                    break;
+                }
+            }
+            if (!clash) break;
+        }
+        if (b == batches.size()) {
+            batches.emplace_back();
+            boxes.emplace_back();
+        }
+        batches[b].push_back(netId);
+        boxes[b].push_back(w);
+    }
+    return batches;
+}
+
 std::vector<Coord3D> buildFallbackPath(const Grid &grid, const Net &net) {
     std::vector<Coord3D> path;
     Coord3D cur = net.pin1; 
@@ -63,20 +300,178 @@ std::vector<Coord3D> buildFallbackPath(const Grid &grid, const Net &net) {
     return path;
 }
 
-void updateDemandAlongPath(Grid &grid, int netId, const std::vector<Coord3D> &coords) {
-    for (const Coord3D &c : coords) {
-        grid.addDemandForNetGCell(netId, c.layer, c.col, c.row);
+// Only the corners of a step-by-step path: the points where it turns or
+// changes layer, plus both ends.  Grid::addPathDemand() and the route file
+// take the straight runs in between as they are.
+std::vector<Coord3D> cornersOf(const std::vector<Coord3D> &path) {
+    // 0 = via, 1 = along a row, 2 = along a column
+    auto axis = [](const Coord3D &a, const Coord3D &b) {
+        return a.layer != b.layer ? 0 : a.row == b.row ? 1 : 2;
+    };
+    std::vector<Coord3D> corners;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (i == 0 || i + 1 == path.size() ||
+            axis(path[i - 1], path[i]) != axis(path[i], path[i + 1]))
+            corners.push_back(path[i]);
+    }
+    return corners;
+}
+
+// one segment per straight run or via between consecutive corners
+std::shared_ptr<const RoutedNet> makeRoutedNet(const Net &net, const std::vector<Coord3D> &corners) {
+    auto routed = std::make_shared<RoutedNet>();
+    routed->name = net.name;
+    routed->segments.reserve(corners.size() > 0 ? corners.size() - 1 : 0);
+    for (size_t i = 1; i < corners.size(); ++i) {
+        routed->segments.push_back(Segment{corners[i - 1], corners[i]});
     }
+    return routed;
+}
+
+void updateDemandAlongPath(Grid &grid, int netId, const std::vector<Coord3D> &coords) {
+    grid.addPathDemand(netId, coords);
 }
 void removeDemandAlongPath(Grid &grid, int netId, const std::vector<Coord3D> &coords){
-    for (const Coord3D &c : coords)
-        grid.removeDemandForNetGCell(netId, c.layer, c.col, c.row);
+    grid.removePathDemand(netId, coords);
 }
 
+// State the runs of a portfolio share: the lowest overflow any of them has
+// reached, and stderr.
+struct Portfolio {
+    std::atomic<long long> bestOverflow{INF};
+    std::mutex logMutex;
+
+    void offer(long long overflow) {
+        long long cur = bestOverflow.load();
+        while (overflow < cur && !bestOverflow.compare_exchange_weak(cur, overflow)) {}
+    }
+};
+
+// One stderr line, written on destruction.  Runs of a portfolio prefix it
+// with their index and hold the log mutex so lines don't interleave.
+class LogLine {
+public:
+    LogLine(Portfolio *portfolio, int run) : portfolio_(portfolio), run_(run) {}
+    LogLine(LogLine &&) = default;
+    ~LogLine() {
+        if (!portfolio_) {
+            std::cerr << os_.str();
+            return;
+        }
+        std::lock_guard<std::mutex> lk(portfolio_->logMutex);
+        std::cerr << "[run " << run_ << "] " << os_.str();
+    }
+    template <class T>
+    LogLine &operator<<(const T &v) {
+        os_ << v;
+        return *this;
+    }
+
+private:
+    Portfolio *portfolio_;
+    int run_;
+    std::ostringstream os_;
+};
+
+// set by requestStop(), possibly from a signal handler
+std::atomic<bool> stopFlag{false};
+static_assert(std::atomic<bool>::is_always_lock_free, "requestStop() must be async-signal-safe");
+
+double secondsSince(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+}
+
+// Deadline and checkpoints, shared by all runs of a portfolio.
+struct RunControl {
+    std::chrono::steady_clock::time_point deadline;
+    std::string checkpointPath;
+    double checkpointInterval = 0;  // seconds, 0 = never
+    int writeThreads = 1;
+
+    std::mutex mu;
+    long long savedOverflow = INF;
+    std::chrono::steady_clock::time_point lastSave = std::chrono::steady_clock::now();
+
+    double secondsLeft() const {
+        return std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+    }
+
+    // Write best() to the checkpoint file if the last write is old enough
+    // and a result with this overflow is no worse than what the file holds;
+    // best() is only called when it will be written.
+    bool save(long long overflow, const std::function<RoutingResult()> &best) {
+        if (checkpointInterval <= 0 || checkpointPath.empty()) return false;
+        std::lock_guard<std::mutex> lk(mu);
+        if (overflow > savedOverflow || secondsSince(lastSave) < checkpointInterval) return false;
+        lastSave = std::chrono::steady_clock::now();
+        if (!writeRouteFile(checkpointPath, best(), writeThreads)) return false;
+        savedOverflow = overflow;
+        return true;
+    }
+};
+
+// The routes of all nets plus a snapshot of the best state so far.  Routes
+// are immutable and shared, so snapshot() only re-points the nets set since
+// the previous snapshot; nothing is deep-copied until materialize().
+class RouteStore {
+public:
+    explicit RouteStore(size_t numNets)
+        : live_(numNets), best_(numNets), changed_(numNets, 0) {}
+
+    void set(int netId, std::shared_ptr<const RoutedNet> routed) {
+        live_[netId] = std::move(routed);
+        if (!changed_[netId]) {
+            changed_[netId] = 1;
+            changedIds_.push_back(netId);
+        }
+    }
+
+    // the live routes, whose demand is on grid, become the best
+    void snapshot(const Grid &grid) {
+        perf::Scope scope("snapshot");
+        for (int netId : changedIds_) {
+            best_[netId] = live_[netId];
+            changed_[netId] = 0;
+        }
+        changedIds_.clear();
+        overflow_ = grid.totalOverflow();
+        wirelength_ = grid.wirelength();
+        vias_ = grid.vias();
+    }
+    long long bestOverflow() const { return overflow_; }
+
+    RoutingResult materialize() const {
+        RoutingResult result;
+        result.nets.reserve(best_.size());
+        for (const auto &routed : best_) result.nets.push_back(routed ? *routed : RoutedNet());
+        result.overflow = overflow_;
+        result.wirelength = wirelength_;
+        result.vias = vias_;
+        return result;
+    }
+
+private:
+    std::vector<std::shared_ptr<const RoutedNet>> live_;
+    std::vector<std::shared_ptr<const RoutedNet>> best_;
+    std::vector<unsigned char> changed_;  // membership in changedIds_
+    std::vector<int> changedIds_;         // nets set since the last snapshot
+    long long overflow_ = INF;
+    long long wirelength_ = 0;
+    long long vias_ = 0;
+};
+
 } // namespace
 
+void requestStop() {
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
+bool stopRequested() {
+    return stopFlag.load(std::memory_order_relaxed);
+}
+
 Graph buildGraphFromGrid(const Grid &grid) {
-    Graph g(totalVertices(grid));
+    Graph g(grid.numCells());
 
     // iterate over every gcell and add edges to its right/down neighbors
     const int L = grid.numLayers();
@@ -123,134 +518,188 @@ Graph buildGraphFromGrid(const Grid &grid) {
 }
 
 std::vector<long long> computeVertexCost(const Grid &grid) {
-    const int total = totalVertices(grid);
+    const int total = grid.numCells();
     std::vector<long long> costs(total, 0);
-    for(int i = 0 ; i < total ; i++)
-    {
-        long long baseCost = 100000;
-        long long alpha = 1000;
-        int demand = grid.demandByIndex(i);
-        int capacity = grid.capacityByIndex(i);
-        int overflow = std::min(20, std::max(0, demand - capacity));
-        costs[i] = alpha * ((1 << overflow) - 1);
-        if(overflow > 0)costs[i] += baseCost;
-    }
+    congestionCosts(grid.demandData(), grid.capacityData(), nullptr, 0, costs.data(), total);
+    blockSentinels(grid, costs);
     return costs;
 }
 
-RoutingResult runRouting(Grid &grid,const std::vector<Net> &nets) {
-    auto startTime = std::chrono::steady_clock::now();
-    std::mt19937 rng(static_cast<unsigned>(
+namespace {
+
+// One router run.  portfolio is null for a lone run; otherwise run is its
+// index and the run gives up once it falls far behind the best overflow.
+RoutingResult routeRun(
+    Grid &grid,
+    const std::vector<Net> &nets,
+    const RouterOptions &options,
+    RunControl &control,
+    Portfolio *portfolio,
+    int run
+) {
+    auto log = [&] { return LogLine(portfolio, run); };
+    const auto runStart = std::chrono::steady_clock::now();
+    std::mt19937 rng(options.seed != 0 ? options.seed : static_cast<unsigned>(
         std::chrono::steady_clock::now().time_since_epoch().count()
     ));
 
-    RoutingResult result;
-    RoutingResult bestResult;
-    result.nets.reserve(nets.size());
-    bestResult.nets.reserve(nets.size());
-    std::vector<std::vector<Coord3D>> pathOfNet(nets.size());
+    RouteStore routes(nets.size());  // 目前的 routing 跟最好的 snapshot
+    bool abandoned = false;
+    std::vector<std::vector<Coord3D>> pathOfNet(nets.size());  // corners only, see cornersOf()
 
     grid.resetDemand();
-    Graph graph = buildGraphFromGrid(grid);
+    SearchState search;  // reused by every search below
+    // parallel reroute: one SearchState per worker, worker 0 reuses search
+    const int threads = std::max(1, options.threads);
+    std::unique_ptr<WorkerPool> pool;
+    std::vector<SearchState> workerSearch;
+    if (threads > 1) {
+        pool.reset(new WorkerPool(threads));
+        workerSearch.resize(threads - 1);
+    }
+    long long batches = 0, batchedNets = 0, deferredNets = 0;
+    auto stateOf = [&](int worker) -> SearchState & {
+        return worker == 0 ? search : workerSearch[worker - 1];
+    };
+
+    // per-net window stats of the latest search, plus totals over all searches
+    std::vector<WindowStats> windowStatsOf(options.window ? nets.size() : 0);
+    long long searches = 0, firstWindow = 0, fullGrid = 0, touched = 0;
+    auto windowStats = [&](size_t netId) -> WindowStats * {
+        return options.window ? &windowStatsOf[netId] : nullptr;
+    };
+    auto countSearch = [&](size_t netId) {
+        if (!options.window) return;
+        const WindowStats &st = windowStatsOf[netId];
+        ++searches;
+        if (st.windows == 1) ++firstWindow;
+        if (st.fullGrid) ++fullGrid;
+        touched += st.touched;
+    };
 
-    const int totalV = totalVertices(grid);
     long long maxIterations = INF;
-    std::vector<long long> history(totalV, 0);
-    int historyInc = 1;     // 每次 overfull +1
-    const long long beta = 1000;        // history 懲罰尺度：你W/H在 5700/6000，beta建議先試 1000~6000
+    int historyInc = 1;     // 每次 overfull +1（negotiated：+ overflow）
+    const long long beta = options.historyBeta;  // history 懲罰尺度：你W/H在 5700/6000，beta建議先試 1000~6000
+    CostMap costMap(beta);  // congestion + beta * history, updated per changed cell
+    // negotiated：present factor 每輪乘 presentGrowth，越來越不准擠
+    const bool negotiated = options.schedule == CostSchedule::Negotiated;
+    // 上限：最長的 path 每格都付 top step 也不能超過 radix heap 的 key 範圍
+    const double maxFactor = maxPresentFactor(options.presentUnit, grid.numCells());
+    double presentFactor = negotiated ? std::min(options.presentFactor, maxFactor) : 0;
+    if (negotiated)
+        costMap.setPresentCosts(negotiatedPresentCosts(presentFactor, options.presentUnit, grid.numCells()));
+    costMap.reset(grid);
+    std::vector<IterationStats> convergence;
+    auto noteIteration = [&](int iter, size_t rerouted) {
+        IterationStats st;
+        st.iter = iter;
+        st.seconds = secondsSince(runStart);
+        st.overflow = grid.totalOverflow();
+        st.overfullCells = static_cast<int>(grid.overfullCells().size());
+        st.rerouted = static_cast<int>(rerouted);
+        st.wirelength = grid.wirelength();
+        st.vias = grid.vias();
+        st.presentFactor = presentFactor;
+        convergence.push_back(st);
+    };
     int stagcnt = 0;
     long long lastOverflow = INF;
+    std::vector<int> overfullHits(nets.size(), 0);  // per net, reset after each selection
+    // 預測下一輪要多久：每條 net reroute 時間的 EMA
+    double perNetSeconds = 0;
+    auto notePerNet = [&](double seconds, size_t routed) {
+        if (routed == 0) return;
+        const double x = seconds / routed;
+        perNetSeconds = perNetSeconds == 0 ? x : 0.7 * perNetSeconds + 0.3 * x;
+    };
 
     for (int iter = 0; iter < maxIterations; ++iter) {
+        perf::Scope iterScope(iter == 0 ? "route-initial" : "rrr-iteration");
+        const auto iterStart = std::chrono::steady_clock::now();
         if (iter == 0) {
-            // baseline routing
+            // baseline routing（一定跑完，不然沒有結果可以輸出）
+            std::unique_ptr<PatternRouter> patterns;
+            if (options.patternRoute) patterns.reset(new PatternRouter(grid, costMap.costs()));
+            std::vector<int> changed;  // gcells the last sync recomputed
+            size_t patternRouted = 0;
             for (size_t netIdx = 0; netIdx < nets.size(); ++netIdx) {
                 const Net &net = nets[netIdx];
-                RoutedNet routed;
-                routed.name = net.name;
 
-                int src = grid.gcellIndex(net.pin1.layer, net.pin1.col, net.pin1.row);
-                int dst = grid.gcellIndex(net.pin2.layer, net.pin2.col, net.pin2.row);
-
-                std::vector<int> predecessors;
-                std::vector<long long> costs = computeVertexCost(grid);
+                {
+                    perf::Scope scope("vertex-cost");
+                    changed.clear();
+                    costMap.sync(grid, patterns ? &changed : nullptr);
+                    if (patterns) patterns->update(changed);
+                }
 
+                // L/Z pattern first; maze search only if every pattern hits a full gcell
                 std::vector<Coord3D> path;
-                std::vector<long long> dist = astar(graph, grid, src, dst, costs, &predecessors);
-                if (dst >= 0 && dst < static_cast<int>(dist.size()) && dist[dst] < INF) {
-                    path = reconstructPath(grid, src, dst, predecessors);
+                if (patterns) {
+                    perf::Scope scope("pattern");
+                    path = patterns->route(net);
+                }
+                if (!path.empty()) {
+                    ++patternRouted;
+                } else {
+                    path = searchNet(grid, net, costMap.costs(), search, options, windowStats(netIdx));
+                    countSearch(netIdx);
                 }
                 if (path.empty()) {
-                    std::cerr << "Warning: using fallback routing for " << net.name << "\n";
+                    log() << "Warning: using fallback routing for " << net.name << "\n";
                     path = buildFallbackPath(grid, net);
                 }
 
-                for (size_t i = 1; i < path.size(); ++i) {
-                    routed.segments.push_back(Segment{path[i - 1], path[i]});
-                }
-                result.nets.push_back(routed);
-                
-                pathOfNet[netIdx] = path;
-                updateDemandAlongPath(grid, static_cast<int>(netIdx), path);
+                pathOfNet[netIdx] = cornersOf(path);
+                routes.set(static_cast<int>(netIdx), makeRoutedNet(net, pathOfNet[netIdx]));
+                updateDemandAlongPath(grid, static_cast<int>(netIdx), pathOfNet[netIdx]);
             }
+            notePerNet(secondsSince(iterStart), nets.size());
+            noteIteration(iter, nets.size());
+            if (patterns)
+                log() << "[pattern] " << patternRouted << "/" << nets.size()
+                      << " nets routed by L/Z patterns\n";
 
-            long long totalOverflow = 0;
-            for (int i = 0; i < totalV; ++i) {
-                int of = grid.demandByIndex(i) - grid.capacityByIndex(i);
-                if (of > 0) totalOverflow += of;
-            }
-            std::cerr << "[RRR] iter=" << iter << " totalOverflow=" << totalOverflow << "\n";
-            bestResult = result;
+            const long long totalOverflow = grid.totalOverflow();
+            log() << "[RRR] iter=" << iter << " totalOverflow=" << totalOverflow << "\n";
+            routes.snapshot(grid);
             lastOverflow = totalOverflow;
+            if (portfolio) portfolio->offer(totalOverflow);
             if (totalOverflow == 0) break;
         }
         else {
-            // 1) 計算 overflow，標記 overfull cells
-            long long totalOverflow = 0;
-            std::vector<int> isOverfull(totalV, 0);
-
-            for (int i = 0; i < totalV; ++i) {
-                int of = grid.demandByIndex(i) - grid.capacityByIndex(i);
-                isOverfull[i] = of > 0 ? 1 : 0;
-                totalOverflow += of > 0 ? of : 0;
-            }
+            // 1) overflow 跟 overfull cells：grid 的 demand 更新時就維護好了
+            const long long totalOverflow = grid.totalOverflow();
 
             // debug / early stop
-            std::cerr << "[RRR] iter=" << iter << " totalOverflow=" << totalOverflow << "\n";
+            log() << "[RRR] iter=" << iter << " totalOverflow=" << totalOverflow << "\n";
+            // 目前的 routes 就是這個 overflow 的 routing，比目前最好的好（或一樣）就 snapshot
+            if (totalOverflow <= routes.bestOverflow()) routes.snapshot(grid);
             if (totalOverflow == 0) break;
 
             // 2) 更新 history：只對 overfull 的 gcell 加重
-            for (int i = 0; i < totalV; ++i) {
-                if (isOverfull[i]) history[i] += historyInc;
+            for (int i : grid.overfullCells())
+                costMap.addHistory(i, negotiated ? grid.demandAt(i) - grid.capacityAt(i) : historyInc);
+            if (negotiated) {
+                // present factor 變了，整張 cost map 重算
+                perf::Scope scope("vertex-cost");
+                presentFactor = std::min(presentFactor * options.presentGrowth, maxFactor);
+                costMap.setPresentCosts(negotiatedPresentCosts(presentFactor, options.presentUnit, grid.numCells()));
+                costMap.refresh(grid);
             }
 
-            // 3) 選出要 reroute 的 nets：只 reroute 路徑碰到 overfull cell 的 net
+            // 3) 選出要 reroute 的 nets：從 overfull cells 直接查經過它的 nets，
+            //    順便算每條 net 壓在幾個 overfull cell 上（排序用）
             std::vector<int> netsToReroute;
-            netsToReroute.reserve(nets.size());
-
-            auto overfullHits = [&](int netId) {
-                int cnt = 0;
-                for (const auto &c : pathOfNet[netId]) {
-                    int idx = grid.gcellIndex(c.layer, c.col, c.row);
-                    if (idx >= 0 && idx < totalV && isOverfull[idx]) ++cnt;
+            for (int idx : grid.overfullCells()) {
+                for (int netId : grid.netsAt(idx)) {
+                    if (overfullHits[netId]++ == 0) netsToReroute.push_back(netId);
                 }
-                return cnt;
-            };
-
-            for (int netId = 0; netId < (int)nets.size(); ++netId) {
-                bool hit = false;
-                for (const auto &c : pathOfNet[netId]) {
-                    int idx = grid.gcellIndex(c.layer, c.col, c.row);
-                    if (idx >= 0 && idx < totalV && isOverfull[idx]) {
-                        hit = true;
-                        break;
-                    }
-                }
-                if (hit) netsToReroute.push_back(netId);
             }
+            // overfullCells() 沒有固定順序，先照 netId 排好，shuffle 的結果才只跟 seed 有關
+            std::sort(netsToReroute.begin(), netsToReroute.end());
             if(stagcnt >=200)
             {
-                std::cerr << "[RRR] stagnation detected, rerouting all nets\n";
+                log() << "[RRR] stagnation detected, rerouting all nets\n";
                 netsToReroute.clear();
                 for (int netId = 0; netId < (int)nets.size(); ++netId) {
                     netsToReroute.push_back(netId);
@@ -263,86 +712,321 @@ RoutingResult runRouting(Grid &grid,const std::vector<Net> &nets) {
             std::stable_sort(
                 netsToReroute.begin(),
                 netsToReroute.end(),
-                [&](int a, int b) { return overfullHits(a) > overfullHits(b); }
+                [&](int a, int b) { return overfullHits[a] > overfullHits[b]; }
             );
+            for (int netId : netsToReroute) overfullHits[netId] = 0;
 
-            // 4) reroute 之前先算一次 costs（以目前 demand + history）
-            //    注意：不要在 reroute 每條 net 都重算整張 costs，成本很高、也不一定更好
-            // 5) 只 reroute 被選到的 nets（rip-up 後才重算 cost，讓 demand 變化被看到）
-            for (int netId : netsToReroute) {
-                const Net &net = nets[netId];
-                // (a) rip-up：先把舊路徑從 demand 拿掉
-                removeDemandAlongPath(grid, netId, pathOfNet[netId]);
-                std::vector<long long> costs = computeVertexCost(grid);
-                for (size_t i = 0; i < costs.size(); ++i) {
-                    // history penalty：讓曾經塞爆的格子在未來更不想走
-                    // 用 min 避免爆掉（可調）
-                    costs[i] += beta * history[i];
-                }
-
-                int src = grid.gcellIndex(net.pin1.layer, net.pin1.col, net.pin1.row);
-                int dst = grid.gcellIndex(net.pin2.layer, net.pin2.col, net.pin2.row);
-
-                std::vector<int> predecessors;
-                std::vector<long long> dist = astar(graph, grid, src, dst, costs, &predecessors);
+            // 剩下的時間不夠 reroute 這些 nets 就停在這裡，保留目前最好的結果
+            const double predicted = perNetSeconds * netsToReroute.size();
+            if (predicted > control.secondsLeft()) {
+                log() << "[RRR] time budget: iter=" << iter << " would take ~" << predicted
+                      << "s, " << std::max(0.0, control.secondsLeft()) << "s left\n";
+                break;
+            }
+            const auto rerouteStart = std::chrono::steady_clock::now();
 
-                std::vector<Coord3D> newPath;
-                if (dst >= 0 && dst < (int)dist.size() && dist[dst] < INF) {
-                    newPath = reconstructPath(grid, src, dst, predecessors);
-                }
+            // (b) commit：更新 routes & pathOfNet & demand
+            auto commit = [&](int netId, std::vector<Coord3D> newPath) {
+                const Net &net = nets[netId];
+                countSearch(netId);
                 if (newPath.empty()) {
-                    std::cerr << "Warning: using fallback routing for " << net.name << "\n";
+                    log() << "Warning: using fallback routing for " << net.name << "\n";
                     newPath = buildFallbackPath(grid, net);
                 }
+                pathOfNet[netId] = cornersOf(newPath);
+                routes.set(netId, makeRoutedNet(net, pathOfNet[netId]));
+                updateDemandAlongPath(grid, netId, pathOfNet[netId]);
+            };
 
-                // (b) commit：更新 result & pathOfNet & demand
-                RoutedNet routed;
-                routed.name = net.name;
-                routed.segments.clear();
-                for (size_t i = 1; i < newPath.size(); ++i) {
-                    routed.segments.push_back(Segment{newPath[i - 1], newPath[i]});
+            // 4) costMap 只重算 demand 有變動的格子，每條 net 前 sync 一次就好
+            // 5) 只 reroute 被選到的 nets（rip-up 後才重算 cost，讓 demand 變化被看到）
+            if (threads > 1) {
+                // 平行版：不互相重疊的 nets 一批一起 rip-up、平行 search，
+                // batch 結束才 commit，所以結果跟 thread 數與排程無關。
+                // 每條 net 只在自己的 box（pin box + batchMargin）裡找，
+                // box 裡找不到（或只找到會 overflow、box 外可能更便宜的路）
+                // 的留到 batch 後面一條一條在整張 grid 上找
+                std::vector<int> deferred;
+                for (const std::vector<int> &batch :
+                     conflictFreeBatches(grid, nets, netsToReroute, options.batchMargin)) {
+                    if (stopRequested()) break;
+                    ++batches;
+                    batchedNets += batch.size();
+                    for (int netId : batch)
+                        removeDemandAlongPath(grid, netId, pathOfNet[netId]);
+                    {
+                        perf::Scope scope("vertex-cost");
+                        costMap.sync(grid);
+                    }
+                    std::vector<std::vector<Coord3D>> newPaths(batch.size());
+                    pool->run(batch.size(), [&](size_t k, int worker) {
+                        const Net &net = nets[batch[k]];
+                        newPaths[k] = searchInWindow(grid, net, costMap.costs(), stateOf(worker), options,
+                                                     windowAround(grid, net, options.batchMargin),
+                                                     windowStats(batch[k]));
+                    });
+                    deferred.clear();
+                    for (size_t k = 0; k < batch.size(); ++k) {
+                        if (newPaths[k].empty()) deferred.push_back(batch[k]);
+                        else commit(batch[k], std::move(newPaths[k]));
+                    }
+                    deferredNets += deferred.size();
+                    for (int netId : deferred) {
+                        {
+                            perf::Scope scope("vertex-cost");
+                            costMap.sync(grid);
+                        }
+                        commit(netId, searchNet(grid, nets[netId], costMap.costs(), search,
+                                                options, windowStats(netId)));
+                    }
+                }
+            } else {
+                for (int netId : netsToReroute) {
+                    if (stopRequested()) break;
+                    // (a) rip-up：先把舊路徑從 demand 拿掉
+                    removeDemandAlongPath(grid, netId, pathOfNet[netId]);
+                    {
+                        // costs = congestion + beta * history（history 讓曾經塞爆的格子更不想走）
+                        perf::Scope scope("vertex-cost");
+                        costMap.sync(grid);
+                    }
+                    commit(netId, searchNet(grid, nets[netId], costMap.costs(), search,
+                                            options, windowStats(netId)));
                 }
-                result.nets[netId] = routed;
-
-                pathOfNet[netId] = newPath;
-                updateDemandAlongPath(grid, netId, newPath);
             }
+            notePerNet(secondsSince(rerouteStart), netsToReroute.size());
+            noteIteration(iter, netsToReroute.size());
             if (totalOverflow >= lastOverflow) {
                 stagcnt++;
             } else {
                 stagcnt = 0;
             }
-            if(totalOverflow <= lastOverflow)
-            {
-                bestResult = result;
-            }
             lastOverflow = std::min(totalOverflow, lastOverflow);
+            // 每條 net 都是整條 rip-up + reroute，grid 在這裡是一致的：
+            // 這輪的結果先比一次，下面 break（放棄、stop、時間到）才不會丟掉它
+            if (grid.totalOverflow() <= routes.bestOverflow()) routes.snapshot(grid);
+        }
+
+        // portfolio：落後最好的 run 太多就放棄，把 CPU 讓給其他 run
+        if (portfolio) {
+            portfolio->offer(routes.bestOverflow());
+            const long long leader = portfolio->bestOverflow.load();
+            if (routes.bestOverflow() > 2 * leader && (leader == 0 || iter >= options.portfolioGrace)) {
+                log() << "[RRR] giving up at iter=" << iter << ": best overflow " << routes.bestOverflow()
+                      << " vs " << leader << "\n";
+                abandoned = true;
+                break;
+            }
         }
 
-        auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
-            std::chrono::steady_clock::now() - startTime
-        ).count();
-        if (elapsed >= 300) {
-            std::cerr << "[RRR] time limit reached (" << elapsed << "s) after iter=" << iter << "\n";
+        if (stopRequested()) {
+            log() << "[RRR] stop requested during iter=" << iter << "\n";
+            break;
+        }
+        if (control.secondsLeft() <= 0) {
+            log() << "[RRR] time budget used up after iter=" << iter << "\n";
             break;
         }
+        if (control.save(routes.bestOverflow(), [&] { return routes.materialize(); }))
+            log() << "[RRR] checkpoint: overflow=" << routes.bestOverflow() << " after iter=" << iter << "\n";
     }
-    return bestResult;
+    if (grid.totalOverflow() <= routes.bestOverflow()) routes.snapshot(grid);
+    if (batches > 0) {
+        log() << "[parallel] threads=" << threads << " batches=" << batches
+              << " avgNets=" << static_cast<double>(batchedNets) / batches
+              << " deferred=" << deferredNets << "\n";
+    }
+    if (options.window && searches > 0) {
+        log() << "[window] searches=" << searches
+              << " firstWindow=" << firstWindow
+              << " grown=" << searches - firstWindow
+              << " fullGrid=" << fullGrid
+              << " avgTouched=" << touched / searches << "\n";
+    }
+    RoutingResult best = routes.materialize();
+    best.windowStats = std::move(windowStatsOf);
+    best.abandoned = abandoned;
+    best.convergence = std::move(convergence);
+    return best;
 }
 
-bool writeRouteFile(const std::string &filename, const RoutingResult &result) {
-    std::ofstream fout(filename);
-    if (!fout) return false;
+} // namespace
+
+RoutingResult runRouting(Grid &grid,const std::vector<Net> &nets, const RouterOptions &options) {
+    RunControl control;
+    control.deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(options.timeBudget));
+    control.checkpointPath = options.checkpointPath;
+    control.checkpointInterval = options.checkpointInterval;
+    control.writeThreads = options.threads;
+    if (options.portfolio <= 1) return routeRun(grid, nets, options, control, nullptr, 0);
+
+    // run i: seed base + i, history beta scaled by 1, 2, 1/2, 4, 1/4, ...
+    const unsigned base = options.seed != 0 ? options.seed : static_cast<unsigned>(
+        std::chrono::steady_clock::now().time_since_epoch().count()
+    );
+    const int runs = options.portfolio;
+    // at most --threads runs at once, the threads split between them; the
+    // rest wait for a free worker and share the same deadline
+    const int workers = std::min(runs, std::max(1, options.threads));
+    Portfolio portfolio;
+    std::vector<RoutingResult> results(runs);
+    std::vector<RouterOptions> runOptions(runs, options);
+    for (int r = 0; r < runs; ++r) {
+        RouterOptions &o = runOptions[r];
+        o.portfolio = 1;
+        o.threads = std::max(1, options.threads / workers);
+        o.seed = base + static_cast<unsigned>(r);
+        if (o.seed == 0) o.seed = 1;  // 0 would mean "seed from the clock"
+        const int shift = std::min((r + 1) / 2, MAX_BETA_SHIFT);
+        const long long beta = options.historyBeta;
+        if (r % 2 == 0) o.historyBeta = std::max(1LL, beta >> shift);
+        else o.historyBeta = beta > (MAX_SCALED_BETA >> shift) ? std::max(beta, MAX_SCALED_BETA) : beta << shift;
+    }
+
+    // least overflow wins, then least wire cost, then the lower run index;
+    // only the best run finished so far keeps its grid and routes, so at
+    // most workers + 1 grid copies are alive
+    std::vector<long long> cost(runs);
+    auto better = [&](int a, int b) {
+        if (results[a].overflow != results[b].overflow) return results[a].overflow < results[b].overflow;
+        if (cost[a] != cost[b]) return cost[a] < cost[b];
+        return a < b;
+    };
+    int best = -1;
+    Grid bestGrid;
+    std::mutex bestMutex;
+    WorkerPool pool(workers);
+    pool.run(static_cast<size_t>(runs), [&](size_t k, int) {
+        const int r = static_cast<int>(k);
+        Grid runGrid = grid;
+        results[r] = routeRun(runGrid, nets, runOptions[r], control, &portfolio, r);
+        cost[r] = results[r].wirelength + results[r].vias * grid.wlViaCost();
+        std::lock_guard<std::mutex> lk(bestMutex);
+        if (best < 0 || better(r, best)) {
+            if (best >= 0) std::vector<RoutedNet>().swap(results[best].nets);
+            best = r;
+            bestGrid = std::move(runGrid);
+        } else {
+            std::vector<RoutedNet>().swap(results[r].nets);
+        }
+    });
+
+    for (int r = 0; r < runs; ++r) {
+        std::cerr << "[portfolio] run " << r << " seed=" << runOptions[r].seed
+                  << " beta=" << runOptions[r].historyBeta
+                  << " overflow=" << results[r].overflow << " cost=" << cost[r]
+                  << (results[r].abandoned ? " (gave up)" : "") << "\n";
+    }
+    std::cerr << "[portfolio] run " << best << " wins\n";
+    grid = std::move(bestGrid);
+    return std::move(results[best]);
+}
+
+namespace {
+
+void appendInt(std::string &out, int v) {
+    char buf[12];
+    char *end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+    out.append(buf, end);
+}
+
+// one net in route file format:
+//   name
+//   (
+//   l1 c1 r1 l2 c2 r2
+//   )
+void appendNet(std::string &out, const RoutedNet &net) {
+    out += net.name;
+    out += "\n(\n";
+    for (const Segment &seg : net.segments) {
+        appendInt(out, seg.from.layer);
+        out += ' ';
+        appendInt(out, seg.from.col);
+        out += ' ';
+        appendInt(out, seg.from.row);
+        out += ' ';
+        appendInt(out, seg.to.layer);
+        out += ' ';
+        appendInt(out, seg.to.col);
+        out += ' ';
+        appendInt(out, seg.to.row);
+        out += '\n';
+    }
+    out += ")\n";
+}
 
-    for (const RoutedNet &net : result.nets) {
-        fout << net.name << "\n";
-        fout << "(\n";
-        for (const Segment &seg : net.segments) {
-            fout << seg.from.layer << " " << seg.from.col << " " << seg.from.row << " "
-                 << seg.to.layer << " " << seg.to.col << " " << seg.to.row << "\n";
+// writev() all of parts to fd, resuming after short writes
+bool writeAll(int fd, std::vector<std::string> &parts) {
+    std::vector<iovec> iov;
+    for (std::string &p : parts) {
+        if (!p.empty()) iov.push_back(iovec{&p[0], p.size()});
+    }
+    size_t first = 0;
+    while (first < iov.size()) {
+        const int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t n = ::writev(fd, &iov[first], count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // skip the buffers written in full, trim the one written in part
+        while (first < iov.size() && static_cast<size_t>(n) >= iov[first].iov_len) {
+            n -= static_cast<ssize_t>(iov[first].iov_len);
+            ++first;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + n;
+            iov[first].iov_len -= static_cast<size_t>(n);
         }
-        fout << ")\n";
     }
+    return true;
+}
 
+} // namespace
+
+bool writeRouteFile(const std::string &filename, const RoutingResult &result, int threads) {
+    // format contiguous chunks of nets into their own buffers (in parallel
+    // when threads > 1), then write the buffers in order with writev()
+    const size_t n = result.nets.size();
+    const size_t chunks = threads > 1 ? std::min(n, static_cast<size_t>(threads) * 4) : 1;
+    std::vector<std::string> parts(std::max<size_t>(chunks, 1));
+    auto format = [&](size_t c, int) {
+        const size_t lo = n * c / chunks, hi = n * (c + 1) / chunks;
+        size_t bytes = 0;
+        for (size_t k = lo; k < hi; ++k)
+            bytes += result.nets[k].name.size() + 5 + 24 * result.nets[k].segments.size();
+        parts[c].reserve(bytes);
+        for (size_t k = lo; k < hi; ++k) appendNet(parts[c], result.nets[k]);
+    };
+    if (chunks > 1) {
+        WorkerPool pool(std::min(threads, static_cast<int>(chunks)));
+        pool.run(chunks, format);
+    } else if (chunks == 1) {
+        format(0, 0);
+    }
+
+    // write a temp file next to the target and rename it over, so a kill
+    // mid-write leaves the previous file intact
+    const std::string tmp = filename + ".tmp";
+    const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    const bool ok = writeAll(fd, parts);
+    if (::close(fd) != 0 || !ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
     return true;
 }
+
+bool writeConvergenceLog(const std::string &filename, const RoutingResult &result) {
+    std::ofstream fout(filename);
+    if (!fout) return false;
+    fout << "iter,seconds,overflow,overfull_cells,rerouted,wirelength,vias,present_factor\n";
+    for (const IterationStats &st : result.convergence) {
+        fout << st.iter << ',' << st.seconds << ',' << st.overflow << ',' << st.overfullCells << ','
+             << st.rerouted << ',' << st.wirelength << ',' << st.vias << ',' << st.presentFactor << '\n';
+    }
+    return static_cast<bool>(fout);
+}
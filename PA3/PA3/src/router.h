@@ -17,24 +17,129 @@ struct RoutedNet {
     std::vector<Segment> segments;  // continuous path in order
 };
 
+/// How the last search of a net went when windowed search is on.
+struct WindowStats {
+    int windows = 0;        // windows tried, 1 = the first one sufficed
+    int width = 0;          // columns of the window that produced the path
+    int height = 0;         // rows of that window
+    bool fullGrid = false;  // had to fall back to the whole grid
+    long long touched = 0;  // vertices the searches wrote, summed over windows
+};
+
+/// One iteration of the convergence log: the state after it.
+struct IterationStats {
+    int iter = 0;               // 0 is the first routing pass
+    double seconds = 0;         // since the run started
+    long long overflow = 0;
+    int overfullCells = 0;
+    int rerouted = 0;           // nets routed in this iteration
+    long long wirelength = 0;
+    long long vias = 0;
+    double presentFactor = 0;   // of the negotiated schedule, 0 for fixed
+};
+
 struct RoutingResult {
     std::vector<RoutedNet> nets;
+    long long overflow = 0;   // total overflow of these routes
+    long long wirelength = 0; // their wire length, sum of W / H
+    long long vias = 0;
+    bool abandoned = false;   // portfolio run that gave up before finishing
+    std::vector<WindowStats> windowStats;  // per net, empty if windows are off
+    std::vector<IterationStats> convergence;  // per iteration of the run returned
+};
+
+enum class CostSchedule { Fixed, Negotiated };
+
+struct RouterOptions {
+    // Search each net inside its pin bounding box grown by windowMargin
+    // gcells; the margin is multiplied by windowGrowth until the path found
+    // adds no overflow or is provably as cheap as any path leaving the
+    // window.  Off by default: the A* heuristic already keeps most searches
+    // small, and congested nets end up growing to the whole grid anyway.
+    bool window = false;
+    int windowMargin = 8;
+    int windowGrowth = 2;
+    // Nets whose pins are at least this many gcells apart (|dcol| + |drow|)
+    // use bidirectional A*; -1 never does.
+    int bidirectionalSpan = 32;
+    // First routing pass tries L/Z patterns before the maze search.
+    bool patternRoute = true;
+    // Reroute with this many threads: the selected nets are split into
+    // batches with disjoint pin boxes (grown by batchMargin gcells), each
+    // batch searched in parallel against the same costs, every net inside
+    // its own box, and committed together.  Nets with no path inside their
+    // box, or only one that adds overflow where a path leaving the box might
+    // be cheaper, are then routed one at a time over the whole grid.  1 keeps the
+    // one-net-at-a-time loop.
+    int threads = 1;
+    int batchMargin = 4;
+    // Shuffle seed of the reroute order; 0 seeds from the clock.
+    unsigned seed = 0;
+    // Weight of the history cost of a gcell, per unit of its history.
+    long long historyBeta = 1000;
+    // How congestion is priced over the iterations.  Fixed: a gcell already
+    // over capacity by o costs 100000 + 1000 * (2^o - 1) in every iteration,
+    // and the history of an overfull gcell grows by 1 per iteration.
+    // Negotiated (PathFinder): a gcell costs presentFactor * presentUnit per
+    // unit it would be over capacity with the net on it, presentFactor is
+    // multiplied by presentGrowth after every iteration, and the history of
+    // an overfull gcell grows by its overflow.
+    CostSchedule schedule = CostSchedule::Fixed;
+    double presentFactor = 0.5;
+    double presentGrowth = 1.5;
+    long long presentUnit = 100000;
+    // Run this many routers, at most threads at a time (each then gets
+    // threads / that many threads of its own), each on its own copy of the grid
+    // with seed seed + i and historyBeta scaled by 1, 2, 1/2, 4, ...; the
+    // least overflow (then wire cost) wins.  A run whose best overflow is
+    // more than twice the best of all runs gives up, right away once some
+    // run reaches zero, otherwise after portfolioGrace iterations.  At most
+    // MAX_PORTFOLIO runs; the scaled beta saturates, so the later ones only
+    // differ in their seed.
+    static constexpr int MAX_PORTFOLIO = 32;
+    int portfolio = 1;
+    int portfolioGrace = 100;
+    // Seconds runRouting() may take.  Before each RRR iteration the time per
+    // rerouted net (an EMA) predicts whether the iteration still fits; if
+    // not, the best result so far is returned.  The first routing pass
+    // always runs to completion.
+    double timeBudget = 300;
+    // Every checkpointInterval seconds (0 = never), an improved best result
+    // is written to checkpointPath through writeRouteFile().
+    std::string checkpointPath;
+    double checkpointInterval = 0;
+    // Open list of the searches: BinaryHeap or RadixHeap (pqueue.h).
+    bool radixHeap = true;
 };
 
 /// Build a graph from the current grid, using preferred directions.
 /// Each GCell becomes one vertex; edges represent allowed moves.
+/// runRouting() searches the equivalent GridGraph view instead.
 Graph buildGraphFromGrid(const Grid &grid);
 
-/// Compute per-vertex congestion cost based on grid.demand().
+/// Compute per-vertex congestion cost based on grid.demand(); INF on the
+/// sentinels of a padded or tiled grid.
 /// Students can modify this function to experiment with other cost models.
 std::vector<long long> computeVertexCost(const Grid &grid);
 
 /// Run routing for all nets.  Students will mainly implement this.
 RoutingResult runRouting(
     Grid &grid,
-    const std::vector<Net> &nets
+    const std::vector<Net> &nets,
+    const RouterOptions &options = RouterOptions()
 );
 
-bool writeRouteFile(const std::string &filename, const RoutingResult &result);
+/// Ask a running runRouting() to return its best result: the current RRR
+/// iteration stops at the next net.  Async-signal-safe.
+void requestStop();
+bool stopRequested();
+
+/// Write the routes to filename.tmp, then rename it over filename.  The
+/// nets are formatted in chunks on up to threads threads and written in
+/// order with writev(); the output does not depend on threads.
+bool writeRouteFile(const std::string &filename, const RoutingResult &result, int threads = 1);
+
+/// result.convergence as CSV, one line per iteration after a header.
+bool writeConvergenceLog(const std::string &filename, const RoutingResult &result);
 
 #endif // ROUTER_H
@@ -0,0 +1,215 @@
+// snapshot.cpp
+#include "snapshot.h"
+#include "mappedfile.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = {'P', 'A', '3', 'S', 'N', 'A', 'P', '\n'};
+constexpr uint32_t ORDER_MARK = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;     // ORDER_MARK as the writer stored it
+    uint64_t payloadBytes;  // everything after the header
+    uint64_t checksum;      // of the payload
+    int32_t xSize;
+    int32_t ySize;
+    int32_t viaCost;
+    char layerDirection[2];
+    char pad[2];
+    uint64_t numNets;
+    uint64_t nameBytes;     // size of the string table's bytes
+};
+static_assert(sizeof(Header) % 8 == 0, "arrays after the header stay aligned");
+
+// two layer names, then one per net
+constexpr uint64_t LAYER_STRINGS = 2;
+
+uint64_t aligned(uint64_t bytes) { return (bytes + 7) & ~uint64_t(7); }
+
+// Sizes of the payload arrays, each padded to 8 bytes.
+struct Layout {
+    uint64_t w, h, caps, pins, offsets, names;
+
+    Layout(const Header &hd) {
+        const uint64_t x = static_cast<uint64_t>(hd.xSize), y = static_cast<uint64_t>(hd.ySize);
+        w = aligned((x - 1) * 4);
+        h = aligned((y - 1) * 4);
+        caps = aligned(2 * x * y * 4);
+        pins = aligned(hd.numNets * 6 * 4);
+        offsets = (LAYER_STRINGS + hd.numNets + 1) * 8;
+        names = aligned(hd.nameBytes);
+    }
+    uint64_t total() const { return w + h + caps + pins + offsets + names; }
+};
+
+// 64-bit checksum over four interleaved lanes so it runs at memory speed;
+// it catches truncation and corruption, nothing adversarial
+uint64_t checksum(const char *p, uint64_t n) {
+    constexpr uint64_t K = 0x9E3779B97F4A7C15ull;
+    uint64_t lane[4] = {1, 2, 3, 4};
+    uint64_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t word;
+            std::memcpy(&word, p + i + 8 * k, 8);
+            lane[k] = (lane[k] ^ word) * K;
+            lane[k] ^= lane[k] >> 29;
+        }
+    }
+    uint64_t sum = n;
+    for (; i < n; ++i) sum = (sum ^ static_cast<unsigned char>(p[i])) * K;
+    for (uint64_t h : lane) {
+        sum = (sum ^ h) * K;
+        sum ^= sum >> 31;
+    }
+    return sum;
+}
+
+bool fail(std::string *error, const std::string &filename, const char *what) {
+    if (error) *error = filename + ": " + what;
+    return false;
+}
+
+} // namespace
+
+bool writeSnapshot(const std::string &filename, const ParsedInput &input, std::string *error) {
+    const Grid &grid = input.grid;
+    const std::vector<Net> &nets = input.nets;
+    if (grid.xSize() < 1 || grid.ySize() < 1) return fail(error, filename, "empty grid");
+
+    std::vector<const std::string *> strings;
+    strings.push_back(&grid.layerInfo(0).name);
+    strings.push_back(&grid.layerInfo(1).name);
+    for (const Net &net : nets) strings.push_back(&net.name);
+
+    Header hd = {};
+    std::memcpy(hd.magic, MAGIC, sizeof(MAGIC));
+    hd.version = SNAPSHOT_VERSION;
+    hd.byteOrder = ORDER_MARK;
+    hd.xSize = grid.xSize();
+    hd.ySize = grid.ySize();
+    hd.viaCost = grid.wlViaCost();
+    hd.layerDirection[0] = grid.layerInfo(0).direction;
+    hd.layerDirection[1] = grid.layerInfo(1).direction;
+    hd.numNets = nets.size();
+    for (const std::string *s : strings) hd.nameBytes += s->size();
+    const Layout layout(hd);
+    hd.payloadBytes = layout.total();
+
+    std::vector<char> payload(hd.payloadBytes, 0);
+    char *p = payload.data();
+    auto ints = [](char *at, uint64_t k, int32_t v) { std::memcpy(at + 4 * k, &v, 4); };
+    for (int j = 0; j + 1 < grid.xSize(); ++j) ints(p, j, grid.horizontalDist(j));
+    p += layout.w;
+    for (int i = 0; i + 1 < grid.ySize(); ++i) ints(p, i, grid.verticalDist(i));
+    p += layout.h;
+    uint64_t k = 0;
+    for (int l = 0; l < 2; ++l)
+        for (int i = 0; i < grid.ySize(); ++i)
+            for (int j = 0; j < grid.xSize(); ++j) ints(p, k++, grid.capacity(l, j, i));
+    p += layout.caps;
+    k = 0;
+    for (const Net &net : nets) {
+        for (const Coord3D &c : {net.pin1, net.pin2}) {
+            ints(p, k++, c.layer);
+            ints(p, k++, c.col);
+            ints(p, k++, c.row);
+        }
+    }
+    p += layout.pins;
+    char *names = p + layout.offsets;
+    uint64_t offset = 0;
+    for (k = 0; k < strings.size(); ++k) {
+        std::memcpy(p + 8 * k, &offset, 8);
+        std::memcpy(names + offset, strings[k]->data(), strings[k]->size());
+        offset += strings[k]->size();
+    }
+    std::memcpy(p + 8 * k, &offset, 8);
+    hd.checksum = checksum(payload.data(), payload.size());
+
+    // same as the route file: write aside, then rename over the target
+    const std::string tmp = filename + ".tmp";
+    {
+        std::ofstream fout(tmp, std::ios::binary);
+        fout.write(reinterpret_cast<const char *>(&hd), sizeof(hd));
+        fout.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+        fout.close();  // flush now: an error in the destructor would go unseen
+        if (!fout) {
+            std::remove(tmp.c_str());
+            return fail(error, filename, "cannot write the file");
+        }
+    }
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return fail(error, filename, "cannot write the file");
+    }
+    return true;
+}
+
+bool loadSnapshot(const std::string &filename, ParsedInput &out, std::string *error) {
+    MappedFile file(filename);
+    if (!file.ok()) return fail(error, filename, "cannot read the file");
+    Header hd;
+    if (file.size() < sizeof(hd)) return fail(error, filename, "not a snapshot");
+    std::memcpy(&hd, file.begin(), sizeof(hd));
+    if (std::memcmp(hd.magic, MAGIC, sizeof(MAGIC)) != 0) return fail(error, filename, "not a snapshot");
+    if (hd.version != SNAPSHOT_VERSION) {
+        if (error)
+            *error = filename + ": snapshot version " + std::to_string(hd.version) +
+                     ", this build reads version " + std::to_string(SNAPSHOT_VERSION);
+        return false;
+    }
+    if (hd.byteOrder != ORDER_MARK) return fail(error, filename, "written on a machine of the other byte order");
+    if (hd.payloadBytes != file.size() - sizeof(hd)) return fail(error, filename, "truncated or extended");
+    // bounds before the layout math, so it can't overflow
+    if (hd.xSize < 1 || hd.ySize < 1 || 2ull * hd.xSize * hd.ySize > 0x7fffffffull ||
+        hd.numNets > hd.payloadBytes || hd.nameBytes > hd.payloadBytes)
+        return fail(error, filename, "bad header");
+    const Layout layout(hd);
+    if (layout.total() != hd.payloadBytes) return fail(error, filename, "bad header");
+    const char *p = file.begin() + sizeof(hd);
+    if (checksum(p, hd.payloadBytes) != hd.checksum) return fail(error, filename, "checksum mismatch");
+
+    const int32_t *w = reinterpret_cast<const int32_t *>(p);
+    const int32_t *h = reinterpret_cast<const int32_t *>(p + layout.w);
+    const int32_t *caps = reinterpret_cast<const int32_t *>(p + layout.w + layout.h);
+    const int32_t *pins = reinterpret_cast<const int32_t *>(p + layout.w + layout.h + layout.caps);
+    const uint64_t *offsets = reinterpret_cast<const uint64_t *>(
+        p + layout.w + layout.h + layout.caps + layout.pins);
+    const char *names = reinterpret_cast<const char *>(offsets) + layout.offsets;
+    const uint64_t numStrings = LAYER_STRINGS + hd.numNets;
+    for (uint64_t k = 0; k < numStrings; ++k)
+        if (offsets[k] > offsets[k + 1]) return fail(error, filename, "bad string table");
+    if (offsets[0] != 0 || offsets[numStrings] != hd.nameBytes)
+        return fail(error, filename, "bad string table");
+    auto name = [&](uint64_t k) { return std::string(names + offsets[k], offsets[k + 1] - offsets[k]); };
+
+    Grid grid;
+    grid.resize(hd.xSize, hd.ySize);
+    grid.setViaCost(hd.viaCost);
+    grid.setHorizontalDistances(std::vector<int>(w, w + hd.xSize - 1));
+    grid.setVerticalDistances(std::vector<int>(h, h + hd.ySize - 1));
+    for (int l = 0; l < 2; ++l) grid.setLayerInfo(l, LayerInfo{name(l), hd.layerDirection[l]});
+    grid.setCapacities(caps);
+
+    std::vector<Net> nets(hd.numNets);
+    for (uint64_t n = 0; n < hd.numNets; ++n) {
+        const int32_t *q = pins + 6 * n;
+        nets[n].name = name(LAYER_STRINGS + n);
+        nets[n].pin1 = Coord3D{q[0], q[1], q[2]};
+        nets[n].pin2 = Coord3D{q[3], q[4], q[5]};
+        if (!grid.contains(nets[n].pin1) || !grid.contains(nets[n].pin2))
+            return fail(error, filename, ("net " + nets[n].name + ": pin outside the grid").c_str());
+    }
+
+    out.grid = std::move(grid);
+    out.nets = std::move(nets);
+    return true;
+}
@@ -0,0 +1,26 @@
+// snapshot.h
+// Binary copy of a parsed design, so repeated runs on the same .cap/.net
+// skip the text parser:
+//
+//   pa3 --cap c.cap --net c.net --dump-snapshot c.snap   (parse once)
+//   pa3 --load-snapshot c.snap --out c.route ...         (every later run)
+//
+// The file is a fixed header (magic, format version, byte order, payload
+// size and checksum, grid size, via cost, counts) followed by 8-byte aligned
+// arrays: W, H, the capacities in gcellIndex order, six ints of pins per
+// net, and a string table (offsets, then bytes) holding the two layer names
+// and the net names.  It is loaded through mmap and rejected when the
+// version, byte order, size or checksum don't match.
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "parser.h"
+#include <string>
+
+constexpr unsigned SNAPSHOT_VERSION = 1;
+
+// On failure *error (when given) says why.
+bool writeSnapshot(const std::string &filename, const ParsedInput &input, std::string *error = nullptr);
+bool loadSnapshot(const std::string &filename, ParsedInput &out, std::string *error = nullptr);
+
+#endif // SNAPSHOT_H
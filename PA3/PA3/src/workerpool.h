@@ -0,0 +1,91 @@
+// workerpool.h
+// Fixed set of threads that run index ranges:
+//
+//   WorkerPool pool(4);
+//   pool.run(n, [&](size_t i, int worker) { ... });  // returns when all n are done
+//
+// The calling thread takes part as worker 0, so a pool of one thread runs
+// everything inline.  worker is in [0, size()) and stays the same for the
+// whole of one call of fn, so per-worker scratch can be indexed by it.
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) {
+        for (int w = 1; w < threads; ++w) threads_.emplace_back([this, w] { loop(w); });
+    }
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (std::thread &t : threads_) t.join();
+    }
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    int size() const { return static_cast<int>(threads_.size()) + 1; }
+
+    void run(size_t n, const std::function<void(size_t, int)> &fn) {
+        if (threads_.empty() || n <= 1) {
+            for (size_t i = 0; i < n; ++i) fn(i, 0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            fn_ = &fn;
+            n_ = n;
+            next_ = 0;
+            busy_ = static_cast<int>(threads_.size());
+            ++generation_;
+        }
+        wake_.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> lk(mu_);
+        done_.wait(lk, [this] { return busy_ == 0; });
+        fn_ = nullptr;
+    }
+
+private:
+    void work(int worker) {
+        for (size_t i; (i = next_.fetch_add(1)) < n_; ) (*fn_)(i, worker);
+    }
+
+    void loop(int worker) {
+        unsigned seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                wake_.wait(lk, [&] { return stop_ || generation_ != seen; });
+                if (stop_) return;
+                seen = generation_;
+            }
+            work(worker);
+            {
+                std::lock_guard<std::mutex> lk(mu_);
+                if (--busy_ == 0) done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads_;
+    std::mutex mu_;
+    std::condition_variable wake_, done_;
+    const std::function<void(size_t, int)> *fn_ = nullptr;
+    size_t n_ = 0;
+    std::atomic<size_t> next_{0};
+    int busy_ = 0;
+    unsigned generation_ = 0;
+    bool stop_ = false;
+};
+
+#endif // WORKER_POOL_H
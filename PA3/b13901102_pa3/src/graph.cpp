@@ -27,10 +27,20 @@ inline int getHeuristic(const Grid &grid, const int u, const int target) {
     return abs(c1.col - c2.col) + abs(c1.row - c2.row);
 }
 
+// OVERFLOW_WEIGHT + 2^min(demand - capacity, 20) * 50, by demand - capacity >= 0
+struct OverflowPenalty {
+    int cost[21] = {};
+    constexpr OverflowPenalty() {
+        for (int o = 0; o <= 20; o++)
+            cost[o] = OVERFLOW_WEIGHT + (1 << o) * 50;
+    }
+};
+constexpr OverflowPenalty overflowPenalty;
+
 inline int getNodeCost(const Grid &grid, const int v, const vector <int> &history) {
     int demand = grid.demandByIndex(v), capacity = grid.capacityByIndex(v), base = 1 + history[v];
     if (demand >= capacity)
-        return base + OVERFLOW_WEIGHT + (1 << min(demand - capacity, 20)) * 50;
+        return base + overflowPenalty.cost[min(demand - capacity, 20)];
     return base;
 }
 
@@ -50,12 +60,14 @@ void dijkstra(const Graph &g, const Grid &grid, const int source, const int targ
             break;
         if (dist[cur.second] != INF && cur.first > dist[cur.second] + getHeuristic(grid, cur.second, target))
             continue;
-        for (const auto &e:g.adj(cur.second))
-            if (getNodeCost(grid, e.to, history) + e.baseCost + dist[cur.second] < dist[e.to]) {
-                dist[e.to] = getNodeCost(grid, e.to, history) + e.baseCost + dist[cur.second];
+        for (const auto &e:g.adj(cur.second)) {
+            const int nd = getNodeCost(grid, e.to, history) + e.baseCost + dist[cur.second];
+            if (nd < dist[e.to]) {
+                dist[e.to] = nd;
                 if (outPrev)
                     (*outPrev)[e.to] = cur.second;
                 pq.emplace(dist[e.to] + getHeuristic(grid, e.to, target), e.to);
             }
+        }
     }
 }
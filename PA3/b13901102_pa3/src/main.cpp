@@ -1,37 +1,79 @@
 // main.cpp
 #include "parser.h"
 #include "router.h"
+#include <csignal>
+#include <exception>
 #include <iostream>
+#include <string>
+
+namespace {
+
+volatile std::sig_atomic_t caughtSignal = 0;
+
+// First SIGINT/SIGTERM: let the router stop and write its best result.
+// SA_RESETHAND makes a second one kill the process as usual.
+void onSignal(int sig) {
+    caughtSignal = sig;
+    requestStop();
+}
+
+} // namespace
 
 int main(int argc, char **argv) {
-    if (argc != 7) {
+    std::string capFile, netFile, outFile;
+    double timeBudget = 580;
+    bool ok = true;
+    for (int i = 1; i < argc && ok; ++i) {
+        const std::string opt = argv[i];
+        if (i + 1 >= argc) {
+            ok = false;
+            break;
+        }
+        const std::string val = argv[++i];
+        if (opt == "--cap") capFile = val;
+        else if (opt == "--net") netFile = val;
+        else if (opt == "--out") outFile = val;
+        else if (opt == "--time-budget") {
+            try {
+                size_t used = 0;
+                timeBudget = std::stod(val, &used);
+                ok = used == val.size() && timeBudget > 0;
+            } catch (const std::exception &) {
+                ok = false;
+            }
+        }
+        else ok = false;
+    }
+    if (!ok || capFile.empty() || netFile.empty() || outFile.empty()) {
         std::cerr << "Usage: "
                   << argv[0]
-                  << " --cap case.cap --net case.net --out case.route\n";
+                  << " --cap case.cap --net case.net --out case.route [--time-budget SECONDS]\n";
         return 1;
     }
 
-    std::string capFile, netFile, outFile;
-    // simple argument parsing (TA implemented)
-    for (int i = 1; i < argc; i += 2) {
-        std::string opt = argv[i];
-        if (opt == "--cap") capFile = argv[i+1];
-        else if (opt == "--net") netFile = argv[i+1];
-        else if (opt == "--out") outFile = argv[i+1];
-    }
-
     ParsedInput input;
     if (!parseInputFiles(capFile, netFile, input)) {
         std::cerr << "Error: failed to parse input files.\n";
         return 1;
     }
 
-    RoutingResult result = runRouting(input.grid, input.nets);
+    struct sigaction sa = {};
+    sa.sa_handler = onSignal;
+    sa.sa_flags = SA_RESETHAND;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    RoutingResult result = runRouting(input.grid, input.nets, timeBudget);
 
     if (!writeRouteFile(outFile, result)) {
         std::cerr << "Error: failed to write route file.\n";
         return 1;
     }
 
+    if (caughtSignal) {
+        std::cerr << "Stopped by signal " << caughtSignal << ", wrote best result to " << outFile << "\n";
+        return 128 + caughtSignal;
+    }
     return 0;
 }
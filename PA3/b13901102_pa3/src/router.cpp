@@ -1,7 +1,9 @@
 // router.cpp
 #include "router.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <numeric>
@@ -12,7 +14,10 @@
 #include <climits>
 
 namespace {
-    constexpr unsigned HISTORY_PUNISHMENT = 1000, TIME_LIMIT = 580, ITER_LIMIT = 100;
+    constexpr unsigned HISTORY_PUNISHMENT = 1000, ITER_LIMIT = 100;
+    // set by requestStop(), possibly from a signal handler
+    std::atomic<bool> stopFlag{false};
+    static_assert(std::atomic<bool>::is_always_lock_free, "requestStop() must be async-signal-safe");
     int totalVertices(const Grid& grid) {return grid.numLayers() * grid.xSize() * grid.ySize();}
     char normalizeDir(char d) {return static_cast<char>(std::toupper(static_cast<unsigned char>(d)));}
     std::vector<Coord3D> reconstructPath(const Grid& grid, int sourceIdx, int targetIdx, const std::vector<int>& prev) {
@@ -60,21 +65,18 @@ namespace {
         for(const Coord3D &c:coords)
             grid.addDemandForNetGCell(netId, c.layer, c.col, c.row);
     }
-    unsigned long long calculateTotalCost(const Grid &grid, const RoutingResult &res) {
+    // wire length + via cost of one path; each step moves to a neighbouring gcell
+    unsigned long long pathCost(const Grid &grid, const std::vector<Coord3D> &path) {
         unsigned long long total_len = 0;
-        int via_cost = grid.wlViaCost();
-        for (const auto& net : res.nets)
-            for (const auto& seg : net.segments)
-                if (seg.from.layer != seg.to.layer)
-                    total_len += via_cost;
-                else {
-                    if (seg.from.col != seg.to.col)
-                        for(int k = std::min(seg.from.col, seg.to.col); k < std::max(seg.from.col, seg.to.col); k++)
-                            total_len += grid.horizontalDist(k);
-                    else if (seg.from.row != seg.to.row)
-                        for(int k=std::min(seg.from.row, seg.to.row); k < std::max(seg.from.row, seg.to.row); k++)
-                            total_len += grid.verticalDist(k);
-                }
+        for (size_t k = 1; k < path.size(); k++) {
+            const Coord3D &a = path[k - 1], &b = path[k];
+            if (a.layer != b.layer)
+                total_len += grid.wlViaCost();
+            else if (a.col != b.col)
+                total_len += grid.horizontalDist(std::min(a.col, b.col));
+            else if (a.row != b.row)
+                total_len += grid.verticalDist(std::min(a.row, b.row));
+        }
         return total_len;
     }
 }
@@ -108,7 +110,7 @@ Graph buildGraphFromGrid(const Grid& grid) {
 
 std::vector<int> computeVertexCost(const Grid& grid) {return {};}
 
-RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
+RoutingResult runRouting(Grid &grid, const vector <Net> &nets, double timeLimit) {
     RoutingResult ret, cur;
     cur.nets.resize(nets.size());
     grid.resetDemand();
@@ -124,10 +126,13 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
     int cells = totalVertices(grid), min_overflow = INF;
     unsigned long long min_cost = LLONG_MAX >> 4;
     vector <int> predecessors(cells), history(cells, 0);
+    // cost of cur, kept up to date as nets are rerouted instead of rescanning every segment
+    vector <unsigned long long> net_costs(nets.size(), 0);
+    unsigned long long total_cost = 0;
     static random_device rd;
     static mt19937 mt(rd());
     auto start_time = steady_clock::now();
-    for (unsigned it = 1, cnt = 0; cnt < ITER_LIMIT && duration_cast<seconds>(steady_clock::now() - start_time).count() / double(it) * (it + 1) <= TIME_LIMIT; it++) {
+    for (unsigned it = 1, cnt = 0; cnt < ITER_LIMIT && duration<double>(steady_clock::now() - start_time).count() / double(it) * (it + 1) <= timeLimit; it++) {
         if (it > 1)
             if (min_overflow > 0) {
                 shuffle(idx.begin(), idx.end(), mt);
@@ -146,6 +151,8 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
             else
                 sort(idx.begin(), idx.end(), cmp);
         for(int i = 0; i < nets.size(); i++) {
+            if (it > 1 && stopFlag.load(std::memory_order_relaxed))
+                break;
             int netIdx = idx[i];
             const Net& net = nets[netIdx];
             if (!netPaths[netIdx].empty()) {
@@ -159,6 +166,9 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
             if (path.empty())
                 path = buildFallbackPath(grid, net);
             updateDemandAlongPath(grid, netIdx, path);
+            total_cost -= net_costs[netIdx];
+            net_costs[netIdx] = pathCost(grid, path);
+            total_cost += net_costs[netIdx];
             netPaths[netIdx] = path;
             RoutedNet routed;
             routed.name = net.name;
@@ -166,6 +176,9 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
                 routed.segments.push_back(Segment{path[j - 1], path[j]});
             cur.nets[netIdx] = routed;
         }
+        // a stop drops the unfinished iteration; ret is the best finished one
+        if (it > 1 && stopFlag.load(std::memory_order_relaxed))
+            break;
         int cur_overflow = 0;
         unsigned long long cur_cost = 0;
         for (int i = 0, x = HISTORY_PUNISHMENT * it * (min_overflow != 0); i < cells; i++)
@@ -175,7 +188,7 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
             }
         bool flag = cur_overflow < min_overflow;
         if (cur_overflow == min_overflow || flag) {
-            cur_cost = calculateTotalCost(grid, cur);
+            cur_cost = total_cost;
             if (cur_cost < min_cost)
                 flag = true;
         }
@@ -198,8 +211,13 @@ RoutingResult runRouting(Grid &grid, const vector <Net> &nets) {
     return ret;
 }
 
+void requestStop() {
+    stopFlag.store(true, std::memory_order_relaxed);
+}
+
 bool writeRouteFile(const std::string& filename, const RoutingResult& result) {
-    std::ofstream fout(filename);
+    const std::string tmp = filename + ".tmp";
+    std::ofstream fout(tmp);
     if(!fout)
         return false;
     for(const RoutedNet& net: result.nets) {
@@ -212,5 +230,10 @@ bool writeRouteFile(const std::string& filename, const RoutingResult& result) {
         fout << ")\n";
     }
 
+    fout.close();
+    if (!fout || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
     return true;
 }
@@ -30,11 +30,20 @@ Graph buildGraphFromGrid(const Grid &grid);
 std::vector<int> computeVertexCost(const Grid &grid);
 
 /// Run routing for all nets.  Students will mainly implement this.
+/// Stops before an iteration that would end after timeLimit seconds, or
+/// at the next net once requestStop() was called; the first iteration
+/// always finishes.
 RoutingResult runRouting(
     Grid &grid,
-    const std::vector<Net> &nets
+    const std::vector<Net> &nets,
+    double timeLimit = 580
 );
 
+/// Asks runRouting() to return its best result so far.  Async-signal-safe.
+void requestStop();
+
+/// Writes filename.tmp and renames it over filename, so a kill mid-write
+/// leaves the previous file in place.
 bool writeRouteFile(const std::string &filename, const RoutingResult &result);
 
 #endif // ROUTER_H